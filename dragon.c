@@ -1,6 +1,9 @@
 // Copyright © Helmut Schellong, 2022
 
 #if !defined(BSH_H)
+# if !defined(_GNU_SOURCE)
+#  define _GNU_SOURCE
+# endif
 #                include <stdio.h>
 #                include <string.h>
 #                include <stdint.h>
@@ -10,6 +13,26 @@
 # define noret  _Noreturn
 # define byte  char
 #endif
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "ref/dragon-xor.h"
+#include "ref/dragon-sync.h"
+#if defined(__has_include)
+# if __has_include(<linux/io_uring.h>)
+#  include <linux/io_uring.h>
+#  include <sys/syscall.h>
+#  include <sys/uio.h>
+# endif
+#endif
+#if defined(IORING_OFF_SQ_RING) && defined(__NR_io_uring_setup)
+# define URING  1
+#else
+# define URING  0
+#endif
 #if !defined(O_BINARY)
 # define O_BINARY  0
 #endif
@@ -32,6 +55,11 @@ static void noret dragE(const char *es, int e)
 # define DRAGON_TEST  0
 #endif
 
+#if !defined(DRAGON_WIDE)
+# define DRAGON_WIDE  0
+#endif
+
+#if DRAGON_WIDE<=0
 # define UPDATE_F()  \
       b^=a, d^=c, f^=e, c+=b, e+=d, a+=f; \
       d^= S1[a>>24&255] ^ S1[a>>16&255] ^ S1[a>>8&255] ^ S2[a&255]; \
@@ -41,19 +69,485 @@ static void noret dragE(const char *es, int e)
       c^= S2[d>>24&255] ^ S2[d>>16&255] ^ S1[d>>8&255] ^ S2[d&255]; \
       e^= S2[f>>24&255] ^ S1[f>>16&255] ^ S2[f>>8&255] ^ S2[f&255]; \
       d+=a, f+=c, b+=e; c^=b, e^=d, a^=f;
+#else
+// SW[xy][v]= Sx[v&255] ^ Sy[v>>8]: two lookups per G/H instead of four (1 MiB)
+# define UPDATE_F()  \
+      b^=a, d^=c, f^=e, c+=b, e+=d, a+=f; \
+      d^= SW[2][a&65535] ^ SW[0][a>>16]; \
+      f^= SW[1][c&65535] ^ SW[0][c>>16]; \
+      b^= SW[0][e&65535] ^ SW[2][e>>16]; \
+      a^= SW[1][b&65535] ^ SW[3][b>>16]; \
+      c^= SW[2][d&65535] ^ SW[3][d>>16]; \
+      e^= SW[3][f&65535] ^ SW[1][f>>16]; \
+      d+=a, f+=c, b+=e; c^=b, e^=d, a^=f;
+static uint32_t SW[4][65536];
+#endif
+
+// B[] is a ring: logical word j of round r sits at B[(j-2*r)&31],
+// so after 16 rounds it is back in place and no word has to move.
+# define DRAGON_RND(r)  \
+      a= B[(32-2*r)&31], b= B[(41-2*r)&31], c= B[(48-2*r)&31]; \
+      d= B[(51-2*r)&31], e= B[(62-2*r)&31]^M>>32, f= B[(63-2*r)&31]^M; \
+      UPDATE_F(); \
+      B[(30-2*r)&31]= b, B[(31-2*r)&31]= c; \
+      M+= 1; \
+      ks[r]= (uint64_t)a<<32 | e;
+# define DRAGON_16RND()  \
+      DRAGON_RND( 0) DRAGON_RND( 1) DRAGON_RND( 2) DRAGON_RND( 3) \
+      DRAGON_RND( 4) DRAGON_RND( 5) DRAGON_RND( 6) DRAGON_RND( 7) \
+      DRAGON_RND( 8) DRAGON_RND( 9) DRAGON_RND(10) DRAGON_RND(11) \
+      DRAGON_RND(12) DRAGON_RND(13) DRAGON_RND(14) DRAGON_RND(15)
 
 static uint32_t const S1[], S2[];
 
 
+// Keystream XOR from i to o (o==i erlaubt), n Bytes, in Stuecken von
+// KS; der Strom muss auf 128 Bytes stehen, nur das Ende darf krumm sein.
+static void dcrypt(uint32_t *B, uint64_t *pM, uint8_t *o, uint8_t const *i, size_t n)
+{
+   static _Alignas(32) uint64_t KS[2*1024];
+   uint64_t M= *pM, *ks;
+   uint32_t a, b, c, d, e, f;
+   size_t l;
+   for (;  n>0;  o+=l,i+=l,n-=l)  {
+      l= n<sizeof(KS) ? n : sizeof(KS);
+      for (ks=KS;  ks<KS+(l+127)/128*16;  ks+=16)  { DRAGON_16RND(); }
+      dragon_xor(o, i, (uint8_t*)KS, l);
+   }
+   *pM= M;
+}
+
+
+// Dauerhaftigkeit des out-file (-s), siehe ref/dragon-sync.h.
+static dragon_sync Dsync= { DRAGON_SYNC_CLOSE, 8u<<20, 0 };
+
+
+// Fuellt p mit bis zu n Bytes; weniger nur am Dateiende.
+static long dread(int fd, uint8_t *p, size_t n)
+{
+   size_t nb; long nr;
+   for (nb=0;  nb<n;  nb+=nr)  {
+      nr= read(fd, p+nb, n-nb);
+      if (nr< 0)  return -1;
+      if (nr==0)  break;
+   }
+   return nb;
+}
+
+
+// Pipeline (-p): Leser-Thread -> Verschluesselung -> Schreiber-Thread
+// ueber einen Ring aus PIPE_N Puffern. Jeder Zaehler hat genau einen
+// Schreiber (SPSC): Prd Leser, Pcr Verschluesselung, Pwr Schreiber.
+// Puffer i%PIPE_N ist frei, solange i-Pwr < PIPE_N.
+#define PIPE_N   8
+#define PIPE_SZ  (1u<<20)     // Vielfaches von 128
+
+static struct { uint8_t *p; long n; }  Pipe[PIPE_N];
+static _Atomic unsigned Prd, Pcr, Pwr;
+static _Atomic int Perr;
+static int Pfd[2];
+static uint64_t Psum;
+
+// Wartet bis *v > i; erst kurz drehen, dann abgeben, dann schlafen.
+static int pwait(_Atomic unsigned *v, unsigned i)
+{
+   unsigned k;
+   for (k=0;  atomic_load_explicit(v, memory_order_acquire)-i-1 > ~0u/2;  ++k)  {
+      if (atomic_load_explicit(&Perr, memory_order_relaxed))  return -1;
+      if (k>=64)  k<1024 ? sched_yield() : usleep(50);
+   }
+   return 0;
+}
+
+static void *preader(void *x)
+{
+   unsigned i; long n;
+   for (i=0;  ;  ++i)  {
+      if (pwait(&Pwr, i-PIPE_N))  break;
+      n= dread(Pfd[0], Pipe[i%PIPE_N].p, PIPE_SZ);
+      if (n<0)  { atomic_store(&Perr, 6); break; }
+      Pipe[i%PIPE_N].n= n;
+      atomic_store_explicit(&Prd, i+1, memory_order_release);
+      if (n<(long)PIPE_SZ)  break;
+   }
+   return x;
+}
+
+static void *pwriter(void *x)
+{
+   unsigned i; long n;
+   for (i=0;  ;  ++i)  {
+      if (pwait(&Pcr, i))  break;
+      n= Pipe[i%PIPE_N].n;
+      if (n>0 && write(Pfd[1], Pipe[i%PIPE_N].p, n)!=n)  { atomic_store(&Perr, 7); break; }
+      Psum+= n;
+      dragon_sync_progress(&Dsync, Pfd[1], Psum);
+      atomic_store_explicit(&Pwr, i+1, memory_order_release);
+      if (n<(long)PIPE_SZ)  break;
+   }
+   return x;
+}
+
+static int dpipe(uint32_t *B, uint64_t *pM)
+{
+   static uint8_t *mem;
+   pthread_t t[2];
+   unsigned i; long n;
+   if (!mem && !(mem= aligned_alloc(64, (size_t)PIPE_N*PIPE_SZ)))  return 8;
+   for (i=0;  i<PIPE_N;  ++i)  Pipe[i].p= mem+(size_t)i*PIPE_SZ;
+   atomic_store(&Prd, 0), atomic_store(&Pcr, 0), atomic_store(&Pwr, 0);
+   atomic_store(&Perr, 0), Psum=0;
+   // Pwr startet bei 0: der Leser darf sofort PIPE_N Puffer fuellen
+   if (pthread_create(&t[0], 0, preader, 0))  return 8;
+   if (pthread_create(&t[1], 0, pwriter, 0))  { atomic_store(&Perr, 8); pthread_join(t[0], 0); return 8; }
+   for (i=0;  ;  ++i)  {
+      if (pwait(&Prd, i))  break;
+      n= Pipe[i%PIPE_N].n;
+      dcrypt(B, pM, Pipe[i%PIPE_N].p, Pipe[i%PIPE_N].p, n);
+      atomic_store_explicit(&Pcr, i+1, memory_order_release);
+      if (n<(long)PIPE_SZ)  break;
+   }
+   pthread_join(t[0], 0);
+   pthread_join(t[1], 0);
+   return Perr;
+}
+
+
+// io_uring (-u[k]), ohne liburing: k Lesevorgaenge laufen voraus,
+// Schreibvorgaenge hinterher, ueber registrierte Puffer (READ_FIXED,
+// WRITE_FIXED). Block j liegt bei Dateiposition j*UR_SZ in Puffer
+// j%(2k). Rueckgabe -1: io_uring nicht benutzbar, noch nichts gelesen.
+#define UR_SZ    (256u<<10)   // Vielfaches von 128
+#define UR_MAXK  64
+
+#if URING
+static struct {
+   int fd;
+   unsigned *sh, *st, *sm, *sa, *ch, *ct, *cm, sn;
+   struct io_uring_sqe *sqe;
+   struct io_uring_cqe *cqe;
+   uint8_t *sq, *cq;
+   size_t sl, cl, ql;
+}  U;
+
+static void urclose(void)
+{
+   if (U.sqe)  munmap(U.sqe, U.ql);
+   if (U.cq && U.cq!=U.sq)  munmap(U.cq, U.cl);
+   if (U.sq)  munmap(U.sq, U.sl);
+   if (U.fd>=0)  close(U.fd);
+   memset(&U, 0, sizeof(U)); U.fd= -1;
+}
+
+static int ursetup(unsigned n)
+{
+   struct io_uring_params p;
+   memset(&p, 0, sizeof(p));
+   memset(&U, 0, sizeof(U));
+   U.fd= syscall(__NR_io_uring_setup, n, &p);
+   if (U.fd<0)  return -1;
+   U.sl= p.sq_off.array + p.sq_entries*sizeof(unsigned);
+   U.cl= p.cq_off.cqes + p.cq_entries*sizeof(struct io_uring_cqe);
+   U.ql= p.sq_entries*sizeof(struct io_uring_sqe);
+   if (p.features&IORING_FEAT_SINGLE_MMAP)  U.sl=U.cl= U.sl>U.cl ? U.sl : U.cl;
+   U.sq= mmap(0, U.sl, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, U.fd, IORING_OFF_SQ_RING);
+   if (U.sq==MAP_FAILED)  { U.sq=0; return -1; }
+   U.cq= U.sq;
+   if (!(p.features&IORING_FEAT_SINGLE_MMAP))  {
+     U.cq= mmap(0, U.cl, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, U.fd, IORING_OFF_CQ_RING);
+     if (U.cq==MAP_FAILED)  { U.cq=0; return -1; }
+   }
+   U.sqe= mmap(0, U.ql, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, U.fd, IORING_OFF_SQES);
+   if (U.sqe==MAP_FAILED)  { U.sqe=0; return -1; }
+   U.sh= (unsigned*)(U.sq+p.sq_off.head), U.st= (unsigned*)(U.sq+p.sq_off.tail);
+   U.sm= (unsigned*)(U.sq+p.sq_off.ring_mask), U.sa= (unsigned*)(U.sq+p.sq_off.array);
+   U.ch= (unsigned*)(U.cq+p.cq_off.head), U.ct= (unsigned*)(U.cq+p.cq_off.tail);
+   U.cm= (unsigned*)(U.cq+p.cq_off.ring_mask);
+   U.cqe= (struct io_uring_cqe*)(U.cq+p.cq_off.cqes);
+   return 0;
+}
+
+// Legt einen Auftrag in den SQ-Ring; urenter() reicht ihn ein.
+static void urprep(int op, int fd, unsigned slot, uint8_t *p, unsigned n, uint64_t off, uint64_t tag)
+{
+   unsigned t= *U.st, i= t & *U.sm;
+   struct io_uring_sqe *q= &U.sqe[i];
+   memset(q, 0, sizeof(*q));
+   q->opcode= op, q->fd= fd, q->addr= (uintptr_t)p, q->len= n, q->off= off;
+   q->buf_index= slot, q->user_data= tag;
+   U.sa[i]= i;
+   __atomic_store_n(U.st, t+1, __ATOMIC_RELEASE);
+   ++U.sn;
+}
+
+static int urenter(unsigned wait)
+{
+   long r;
+   do  r= syscall(__NR_io_uring_enter, U.fd, U.sn, wait, wait?IORING_ENTER_GETEVENTS:0, 0, 0);
+   while (r<0 && errno==EINTR);
+   if (r<0)  return -1;
+   U.sn-= r;
+   return 0;
+}
+
+static int during(int fd[2], uint32_t *B, uint64_t *pM, unsigned k, uint64_t *sum)
+{
+   uint8_t *mem;
+   struct iovec iov[2*UR_MAXK];
+   unsigned st[2*UR_MAXK], got[2*UR_MAXK], put[2*UR_MAXK];
+   uint64_t nr=0, nc=0, last=~0ull, blk[2*UR_MAXK];
+   unsigned nb= 2*k, s, fly=0, h;
+   int r=0;
+   if (lseek(fd[0], 0, SEEK_CUR)<0 || lseek(fd[1], 0, SEEK_CUR)<0)  return -1;
+   if (!(mem= aligned_alloc(4096, (size_t)nb*UR_SZ)))  return -1;
+   if (ursetup(nb)<0)  { urclose(); free(mem); return -1; }
+   for (s=0;  s<nb;  ++s)  iov[s].iov_base= mem+(size_t)s*UR_SZ, iov[s].iov_len= UR_SZ, st[s]=0;
+   if (syscall(__NR_io_uring_register, U.fd, IORING_REGISTER_BUFFERS, iov, nb)<0)  { urclose(); free(mem); return -1; }
+   // st: 0 frei, 1 liest, 2 gelesen, 3 schreibt
+   while (1)  {
+      for (;  nr<=last && nr<nc+k && st[s=nr%nb]==0;  ++nr,++fly)  {
+         st[s]=1, blk[s]=nr, got[s]=0;
+         urprep(IORING_OP_READ_FIXED, fd[0], s, iov[s].iov_base, UR_SZ, nr*UR_SZ, s);
+      }
+      s= nc%nb;
+      if (nc<=last && st[s]==2 && blk[s]==nc)  {
+        dcrypt(B, pM, iov[s].iov_base, iov[s].iov_base, got[s]);
+        if (got[s]<UR_SZ)  last=nc;
+        if (got[s]>0)  {
+          st[s]=3, put[s]=0, ++fly;
+          urprep(IORING_OP_WRITE_FIXED, fd[1], s, iov[s].iov_base, got[s], nc*UR_SZ, s);
+        }
+        else  st[s]=0;
+        *sum+= got[s], ++nc;
+        continue;
+      }
+      if (nc>last && fly==0)  break;
+      if (urenter(__atomic_load_n(U.ct, __ATOMIC_ACQUIRE)==*U.ch))  { r=8; break; }
+      for (h=*U.ch;  h!=__atomic_load_n(U.ct, __ATOMIC_ACQUIRE);  ++h)  {
+         struct io_uring_cqe *c= &U.cqe[h & *U.cm];
+         s= c->user_data;
+         if (c->res<0)  { r= st[s]==1 ? 6 : 7; break; }
+         if (st[s]==1)  {
+           got[s]+= c->res;
+           if (c->res>0 && got[s]<UR_SZ)
+             urprep(IORING_OP_READ_FIXED, fd[0], s, (uint8_t*)iov[s].iov_base+got[s],
+                    UR_SZ-got[s], blk[s]*UR_SZ+got[s], s);
+           else  st[s]=2, --fly;
+         }
+         else  {
+           put[s]+= c->res;
+           if (c->res>0 && put[s]<got[s])
+             urprep(IORING_OP_WRITE_FIXED, fd[1], s, (uint8_t*)iov[s].iov_base+put[s],
+                    got[s]-put[s], blk[s]*UR_SZ+put[s], s);
+           else if (put[s]<got[s])  { r=7; break; }
+           else  st[s]=0, --fly, dragon_sync_progress(&Dsync, fd[1], blk[s]*UR_SZ+got[s]);
+         }
+      }
+      __atomic_store_n(U.ch, h, __ATOMIC_RELEASE);
+      if (r)  break;
+   }
+   urclose();
+   free(mem);
+   return r;
+}
+#else
+static int during(int fd[2], uint32_t *B, uint64_t *pM, unsigned k, uint64_t *sum)
+{
+   return (void)fd, (void)B, (void)pM, (void)k, (void)sum, -1;
+}
+#endif
+
+
+// mmap (-m): Eingabe und die auf volle Laenge gebrachte Ausgabe werden
+// fensterweise abgebildet, dcrypt() arbeitet von Abbild zu Abbild.
+// Ein Fenster ist ein Vielfaches von 2 MiB (Seiten, Huge Pages, 128).
+// Mit -so wird jedes Fenster vor munmap() per msync() festgeschrieben.
+// Wird die Eingabe waehrenddessen gekuerzt, gibt es SIGBUS.
+// Rueckgabe -1: keine regulaeren Dateien/mmap nicht moeglich.
+#if !defined(MAP_WIN)
+# define MAP_WIN  (sizeof(void*)<8 ? (size_t)64<<20 : (size_t)1<<30)
+#endif
+
+static int dmap(int fd[2], uint32_t *B, uint64_t *pM, uint64_t *sum)
+{
+   struct stat st, so;
+   uint8_t *mi, *mo;
+   off_t off; size_t n;
+   int e;
+   if (fstat(fd[0], &st)<0 || !S_ISREG(st.st_mode))  return -1;
+   if (fstat(fd[1], &so)<0 || !S_ISREG(so.st_mode))  return -1;
+   if (st.st_size==0)  return 0;
+   if ((e= posix_fallocate(fd[1], 0, st.st_size)) && (e==ENOSPC||ftruncate(fd[1], st.st_size)<0))  return 7;
+   for (off=0;  off<st.st_size;  off+=n)  {
+      n= (size_t)(st.st_size-off<(off_t)MAP_WIN ? st.st_size-off : (off_t)MAP_WIN);
+      mi= mmap(0, n, PROT_READ, MAP_SHARED, fd[0], off);
+      if (mi==MAP_FAILED)  return off ? 6 : -1;
+      mo= mmap(0, n, PROT_READ|PROT_WRITE, MAP_SHARED, fd[1], off);
+      if (mo==MAP_FAILED)  { munmap(mi, n); return off ? 7 : -1; }
+      madvise(mi, n, MADV_SEQUENTIAL);
+      madvise(mo, n, MADV_SEQUENTIAL);
+#     if defined(MADV_HUGEPAGE)
+      madvise(mi, n, MADV_HUGEPAGE);
+      madvise(mo, n, MADV_HUGEPAGE);
+#     endif
+      dcrypt(B, pM, mo, mi, n);
+      e= Dsync.mode==DRAGON_SYNC_WRITE ? msync(mo, n, MS_SYNC) : 0;
+      munmap(mi, n);
+      munmap(mo, n);
+      if (e<0)  return 7;
+      *sum+= n;
+      dragon_sync_progress(&Dsync, fd[1], *sum);
+   }
+   return 0;
+}
+
+
+// In-place (-i): die Datei wird in Stuecken zu IP_SZ ueber sich selbst
+// verschluesselt. Vor jedem Stueck kommt ein Satz nach name.dragon,
+// abwechselnd in einen von zwei Plaetzen: Position, Laenge und je
+// IP_U Bytes die Pruefsummen von Klar- und Chiffretext; dann fdatasync.
+// Erst danach wird das Stueck geschrieben und festgeschrieben.
+// Nach einem Abbruch ist alles vor dem Stueck des neuesten gueltigen
+// Satzes fertig, alles dahinter unberuehrt, und jede Einheit des
+// Stuecks selbst entweder alt oder neu; das zeigen die Pruefsummen.
+// Der Schluesselstrom bis zum Stueck wird neu erzeugt und verworfen.
+// Jede Einheit muss, alt oder neu, mit dem Schluessel die jeweils
+// andere Pruefsumme ergeben; sonst (falscher Schluessel) Abbruch.
+#define IP_SZ  (4u<<20)      // Vielfaches von 128 und IP_U
+#define IP_U   4096u
+#define IP_NU  (IP_SZ/IP_U)
+
+static struct ipj {
+   char     magic[8];        // "DRAGONi1"
+   uint64_t seq, size, pos, len, sum;
+   uint64_t h[IP_NU][2];     // Klartext, Chiffretext
+}  J, Jr[2];
+
+static uint64_t dhash(uint8_t const *p, size_t n)
+{
+   uint64_t h= 0x447261676F6Eull^n, w;
+   for (;  n>=8;  p+=8,n-=8)  memcpy(&w, p, 8), h= (h^w)*0x9E3779B97F4A7C15ull, h^= h>>29;
+   for (;  n>0;  ++p,--n)  h= (h^*p)*0x9E3779B97F4A7C15ull, h^= h>>29;
+   return h;
+}
+
+// Pruefsumme eines Satzes, mit sum=0 gerechnet.
+static uint64_t dhashj(struct ipj *j)
+{
+   uint64_t s= j->sum, h;
+   j->sum= 0, h= dhash((uint8_t*)j, sizeof(*j)), j->sum= s;
+   return h;
+}
+
+static int dpio(int fd, uint8_t *p, size_t n, uint64_t off, int w)
+{
+   size_t nb; long nr;
+   for (nb=0;  nb<n;  nb+=nr)  {
+      nr= w ? pwrite(fd, p+nb, n-nb, off+nb) : pread(fd, p+nb, n-nb, off+nb);
+      if (nr<=0)  return -1;
+   }
+   return 0;
+}
+
+static int dinplace(int fd, char const *name, uint32_t *B, uint64_t *pM, uint64_t *sum)
+{
+   struct stat st;
+   char jn[4096], *sl;
+   uint8_t *p, *x;
+   uint64_t pos=0, seq=0, len, u, nu, ul, h;
+   int jf, df, i, r=0, old=0;
+   if (fstat(fd, &st)<0)  return 6;
+   if (snprintf(jn, sizeof(jn), "%s.dragon", name)>=(int)sizeof(jn))  return 9;
+   if (!(p= aligned_alloc(64, 2*(size_t)IP_SZ)))  return 8;
+   x= p+IP_SZ;
+   if ((jf= open(jn, O_RDWR|O_BINARY))>=0)  {
+     for (i=0;  i<2;  ++i)  {
+        if (dpio(jf, (uint8_t*)&Jr[i], sizeof(J), i*sizeof(J), 0)<0 ||
+            memcmp(Jr[i].magic, "DRAGONi1", 8) || Jr[i].sum!=dhashj(&Jr[i]))  Jr[i].seq=0;
+     }
+     i= Jr[1].seq>Jr[0].seq;
+     // kein gueltiger Satz: abgebrochen, bevor ein Stueck geschrieben war
+     if (Jr[i].seq)  {
+       J= Jr[i], seq= J.seq, pos= J.pos, old=1;
+       if (J.size!=(uint64_t)st.st_size || J.len>IP_SZ || J.pos%IP_SZ)  r=10;
+       memset(x, 0, IP_SZ);
+       for (u=0;  !r&&u<pos;  u+=len)  {
+          len= pos-u<IP_SZ ? pos-u : IP_SZ;
+          dcrypt(B, pM, x, x, len);
+       }
+     }
+   }
+   else  {
+     jf= open(jn, O_RDWR|O_BINARY|O_CREAT|O_EXCL, 0600);
+     if (jf<0)  r=9;
+     // der Eintrag des Journals muss vor dem ersten Stueck fest sein
+     else  {
+       if ((sl= strrchr(jn, '/')))  *sl=0;
+       if ((df= open(sl?(*jn?jn:"/"):".", O_RDONLY))>=0)  fsync(df), close(df);
+       if (sl)  *sl='/';
+     }
+   }
+   while (!r && pos<(uint64_t)st.st_size)  {
+      len= st.st_size-pos<IP_SZ ? st.st_size-pos : IP_SZ;
+      nu= (len+IP_U-1)/IP_U;
+      if (dpio(fd, p, len, pos, 0)<0)  { r=6; break; }
+      memcpy(x, p, len);
+      dcrypt(B, pM, x, x, len);
+      if (old)  {
+        if (J.len!=len)  { r=10; break; }
+        for (u=0;  u<nu;  ++u)  {
+           ul= len-u*IP_U<IP_U ? len-u*IP_U : IP_U;
+           h= dhash(p+u*IP_U, ul);
+           // neu: x ist der daraus entschluesselte Klartext
+           if (h==J.h[u][1])  {
+             if (dhash(x+u*IP_U, ul)!=J.h[u][0])  r=10;
+             else  memcpy(x+u*IP_U, p+u*IP_U, ul);
+           }
+           else if (h!=J.h[u][0] || dhash(x+u*IP_U, ul)!=J.h[u][1])  r=10;
+        }
+        if (r)  break;
+        old=0;
+      }
+      else  {
+        memset(&J, 0, sizeof(J));
+        memcpy(J.magic, "DRAGONi1", 8);
+        J.seq= ++seq, J.size= st.st_size, J.pos= pos, J.len= len;
+        for (u=0;  u<nu;  ++u)  {
+           ul= len-u*IP_U<IP_U ? len-u*IP_U : IP_U;
+           J.h[u][0]= dhash(p+u*IP_U, ul), J.h[u][1]= dhash(x+u*IP_U, ul);
+        }
+        J.sum= dhashj(&J);
+        if (dpio(jf, (uint8_t*)&J, sizeof(J), (seq&1)*sizeof(J), 1)<0 || fdatasync(jf)<0)  { r=9; break; }
+      }
+      if (dpio(fd, x, len, pos, 1)<0 || fdatasync(fd)<0)  { r=7; break; }
+      pos+=len, *sum+=len;
+   }
+   free(p);
+   if (jf>=0)  close(jf);
+   if (!r)  unlink(jn);
+   return r;
+}
+
+
 static int dragon(int C, char *A[])
 {
-   static char args[]= "dragon  key init  in out\n"
-                       "(key,init: 64 hex-digits (256 Bit), in-file, out-file)";
+   static char args[]= "dragon  [-p|-u[k]|-m] [-s{n|d|r[N]|o}] key init  in out\n"
+                       "dragon  -i key init  file\n"
+                       "(key,init: 64 hex-digits (256 Bit), in-file, out-file)\n"
+                       "-p: Lesen, Verschluesseln, Schreiben in drei Threads\n"
+                       "-u: io_uring, k Lesevorgaenge voraus (1..64, 8)\n"
+                       "-m: mmap, von Abbild zu Abbild\n"
+                       "-s: out-file festschreiben: n nie, d fdatasync am Ende (Standard),\n"
+                       "    r wie d und alle N MiB zurueckschreiben (8), o jedes write (O_SYNC)\n"
+                       "    (o: nach Absturz bleibt ein Anfang; nicht so bei -u und -m)\n"
+                       "-i: file ueber sich selbst, fortsetzbar ueber file.dragon";
    static _Bool pass;
-   uint64_t W[8][2], M, K[4], I[4], q, sum=0;
+   static _Alignas(32) uint64_t buf[2*1024], KS[16];
+   uint64_t W[8][2], M, K[4], I[4], *ks, q, sum=0;
    uint32_t B[32], a, b, c, d, e, f;
    unsigned i, p;
-   int fd[2];
+   int fd[2], o, r=0, mode=0;
+   unsigned depth=8;
 #  if !defined(BSH_H)
    static char Chex[256];
    static char Chex0[]= "0123456789ABCDEFabcdef";
@@ -67,7 +561,36 @@ static int dragon(int C, char *A[])
      return 0;
    }
    if (!pass&&DRAGON_TEST==0)  return 0;
-   if (C!=5)  dragE(args, 1);
+   for (o=1;  o<C&&A[o][0]=='-'&&A[o][1];  ++o)  {
+      switch (A[o][1])  {
+        case 'p':  mode='p'; break;
+        case 'm':  mode='m'; break;
+        case 'i':  mode='i'; break;
+        case 's':  switch (A[o][2])  {
+                     case 'n':  Dsync.mode= DRAGON_SYNC_NONE;  break;
+                     case 'd':  Dsync.mode= DRAGON_SYNC_CLOSE; break;
+                     case 'o':  Dsync.mode= DRAGON_SYNC_WRITE; break;
+                     case 'r':  Dsync.mode= DRAGON_SYNC_RANGE;
+                                if (A[o][3])  Dsync.every= (uint64_t)atoi(A[o]+3)<<20;
+                                if (!Dsync.every)  dragE(args, 1);
+                                break;
+                     default :  dragE(args, 1);
+                   }
+                   break;
+        case 'u':  mode='u';
+                   if (A[o][2])  depth= atoi(A[o]+2);
+                   if (depth<1||depth>UR_MAXK)  dragE(args, 1);
+                   break;
+        default :  dragE(args, 1);
+      }
+   }
+   A+= o-1, C-= o-1;
+   if (C!=(mode=='i'?4:5))  dragE(args, 1);
+#  if DRAGON_WIDE>0
+   if (!SW[0][1])  { uint32_t const *S[2]= { S1, S2 };
+      for (i=0;  i<4*65536;  ++i)  SW[i>>16][i&65535]= S[i>>17][i&255] ^ S[i>>16&1][i>>8&255];
+   }
+#  endif
    for (i=0;  i<4;  ++i)  K[i]=I[i]= 0;
    for (p=1;  p<3;  ++p)  { char *ap, h; unsigned m; uint64_t *P; unsigned nb;
       ap= A[p]; P= p==1 ?  K : I;
@@ -87,10 +610,14 @@ static int dragon(int C, char *A[])
                    break;
       }
    }
-   if (DRAGON_TEST<=0)  {
+   if (DRAGON_TEST<=0 && mode=='i')  {
+     fd[0]=fd[1]= open(A[3], O_RDWR|O_BINARY);
+     if (fd[0]<0)  dragE("Oeffnen file" , 4);
+   }
+   else if (DRAGON_TEST<=0)  {
      fd[0]= open(A[3], O_RDONLY|O_BINARY);
      if (fd[0]<0)  dragE("Oeffnen in-file" , 4);
-     fd[1]= open(A[4], O_WRONLY|O_BINARY|O_CREAT|O_TRUNC|O_SYNC, 0644);
+     fd[1]= open(A[4], (mode=='m'?O_RDWR:O_WRONLY)|O_BINARY|O_CREAT|O_TRUNC|dragon_sync_flags(&Dsync), 0644);
      if (fd[1]<0)  dragE("Oeffnen out-file", 5);
    }
    W[0][0]= K[0], W[0][1]= K[1];
@@ -113,37 +640,44 @@ static int dragon(int C, char *A[])
       M= (uint64_t)e<<32 | f;
    }
    for (i=0;  i<8;  i+=1)  B[4*i]= W[i][0]>>32, B[4*i+1]= W[i][0], B[4*i+2] = W[i][1]>>32, B[4*i+3] = W[i][1];
-   int nb=0, nk=0, wr=16;
-   while (1)  { uint64_t k, buf[2*1024];
-      a= B[0]; b= B[9]; c= B[16]; d= B[19]; e= B[30]^M>>32; f= B[31]^M;
-      UPDATE_F();
-      for (i=31;  i>1;  --i)  B[i]= B[i-2];
-      B[0]= b; B[1]= c;
-      M+= 1;
-      k= (uint64_t)a<<32 | e;
-      if (DRAGON_TEST>0)  {
-        if (wr-->0)  {
-          for (i=0; i<8; ++i)  printf("%02hhX", (byte)(k>>8*(7-i)));
-          printf(wr%4==0?"\n":" ");  continue;
-        }
-        else  return 0;
-      }
-      if (nb<=0)  {
-        nb= read(fd[0], buf, sizeof(buf));
-        if (nb< 0)  dragE("Lesen des in-file", 6);
-        if (nb<=0)  break;
-      }
-      if (nb>0)  {
-        buf[nk++]^= k, nb-=sizeof(k);
-        if (nb<=0)  { int nw;
-          nw= write(fd[1], buf, (wr= nk*sizeof(k)+nb, wr));
-          if (nw!=wr)  dragE("Schreiben des out-file", 7);
-          if (nk=0,sum+=nw, nb<0)  break;
-        }
-      }
+   if (DRAGON_TEST>0)  {
+     ks= KS; DRAGON_16RND();
+     for (p=0;  p<16;  ++p)  {
+        for (i=0; i<8; ++i)  printf("%02hhX", (byte)(KS[p]>>8*(7-i)));
+        printf(p%4==3?"\n":" ");
+     }
+     return 0;
+   }
+   if (mode=='u' && (r= during(fd, B, &M, depth, &sum))<0)  {
+     fprintf(stderr, "dragon: io_uring nicht verfuegbar, read/write\n");
+     mode=r=0;
+   }
+   if (mode=='m' && (r= dmap(fd, B, &M, &sum))<0)  mode=r=0;
+   if (mode=='p')  Pfd[0]= fd[0], Pfd[1]= fd[1], r= dpipe(B, &M), sum= Psum;
+   if (mode=='i')  r= dinplace(fd[0], A[3], B, &M, &sum);
+   switch (r)  {
+     case 6:  dragE("Lesen des in-file", 6);
+     case 7:  dragE("Schreiben des out-file", 7);
+     case 8:  dragE(mode=='p' ? "Pipeline-Threads/Puffer" : mode=='i' ? "Speicher" : "io_uring", 8);
+     case 9:  dragE("Schreiben des Journals file.dragon", 9);
+     case 10: dragE("Journal file.dragon passt nicht zu file/key/init", 10);
+   }
+   // Fill buf completely, then generate its keystream in one pass and
+   // XOR it in with dragon_xor(); only the last buffer may be short.
+   if (!mode)  while (1)  { long nb, nw;
+      nb= dread(fd[0], (uint8_t*)buf, sizeof(buf));
+      if (nb< 0)  dragE("Lesen des in-file", 6);
+      if (nb<=0)  break;
+      dcrypt(B, &M, (uint8_t*)buf, (uint8_t*)buf, nb);
+      nw= write(fd[1], buf, nb);
+      if (nw!=nb)  dragE("Schreiben des out-file", 7);
+      sum+=nw;
+      dragon_sync_progress(&Dsync, fd[1], sum);
+      if (nb<(long)sizeof(buf))  break;
    }
+   if (dragon_sync_close(&Dsync, fd[1]))  dragE("Schreiben des out-file", 7);
    close(fd[0]);
-   close(fd[1]);
+   if (fd[1]!=fd[0])  close(fd[1]);
    printf("dragon: %lld Bytes\n", (long long)sum);
    return 0;
 }
@@ -242,6 +776,8 @@ static uint32_t const S2[256]= {
 
 
 #undef UPDATE_F
+#undef DRAGON_RND
+#undef DRAGON_16RND
 
 
 
@@ -365,10 +901,18 @@ int main(int ac, char *av[])
    };
    static char *avp[]= { "dragon", "XxxXxxx", 0 };
 
-   if (DRAGON_TEST==0)  {
-     if (ac!=3)  return 1;
-     argv[3]= av[1], argv[4]= av[2];
+   if (DRAGON_TEST==0)  { char **v; int o, n, nf=2;
+     // Optionen vor die Schluessel, die Dateien dahinter
+     for (o=1;  o<ac&&av[o][0]=='-'&&av[o][1];  ++o)  if (av[o][1]=='i')  nf=1;
+     if (ac-o!=nf)  return 1;
+     if (!(v= malloc((ac+3)*sizeof(*v))))  return 1;
+     v[0]= argv[0];
+     for (n=1;  n<o;  ++n)  v[n]= av[n];
+     v[n++]= argv[1], v[n++]= argv[2];
+     for (;  o<ac;  ++o)  v[n++]= av[o];
+     v[n]= 0;
      dragon(2, avp);
+     return dragon(n, v);
    }
    return dragon(5, argv);
 }
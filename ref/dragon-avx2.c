@@ -0,0 +1,308 @@
+/**
+ * @file dragon-avx2.c
+ * AVX2 implementation of Dragon, 8 streams in lockstep
+ * This source is provided without warranty
+ * or guarantee of any kind. Use at your own risk.
+ */
+#include <assert.h>
+#include <immintrin.h>
+
+#include "dragon-dispatch.h"
+#include "dragon-sboxes.c"
+#include "dragon-schedule.h"
+
+/**
+ * Each of the 8 32-bit lanes of a vector holds the corresponding word
+ * of a different stream. The virtual 32x32 s-boxes are evaluated with
+ * one gather per byte position.
+ */
+#define X8_BYTE(x, n) \
+    _mm256_and_si256(_mm256_srli_epi32(x, 8 * (n)), _mm256_set1_epi32(0xFF))
+
+#define X8_SBOX(s0, s1, s2, s3, x) \
+    _mm256_xor_si256( \
+      _mm256_xor_si256( \
+        _mm256_i32gather_epi32((const int*)s0, X8_BYTE(x, 0), 4), \
+        _mm256_i32gather_epi32((const int*)s1, X8_BYTE(x, 1), 4)), \
+      _mm256_xor_si256( \
+        _mm256_i32gather_epi32((const int*)s2, X8_BYTE(x, 2), 4), \
+        _mm256_i32gather_epi32((const int*)s3, _mm256_srli_epi32(x, 24), 4)))
+
+#define X8_G1(x) X8_SBOX(sbox2, sbox1, sbox1, sbox1, x)
+#define X8_G2(x) X8_SBOX(sbox1, sbox2, sbox1, sbox1, x)
+#define X8_G3(x) X8_SBOX(sbox1, sbox1, sbox2, sbox1, x)
+#define X8_H1(x) X8_SBOX(sbox1, sbox2, sbox2, sbox2, x)
+#define X8_H2(x) X8_SBOX(sbox2, sbox1, sbox2, sbox2, x)
+#define X8_H3(x) X8_SBOX(sbox2, sbox2, sbox1, sbox2, x)
+
+#define X8_XOR(x, y) _mm256_xor_si256(x, y)
+#define X8_ADD(x, y) _mm256_add_epi32(x, y)
+
+/**
+ * X8_RND is BASIC_RND applied to 8 transposed NLFSRs. The 64-bit
+ * counter carry is propagated per block. The two keystream words of
+ * each block are appended to out.
+ */
+#define X8_RND(nlfsr, a, loc_a, b, loc_b, c, loc_c, \
+                      d, loc_d, e, loc_e, f, loc_fb1, c1, c2, in, out) \
+    a = nlfsr[loc_a]; \
+    c = nlfsr[loc_c]; \
+    e = X8_XOR(nlfsr[loc_e], c1); \
+    b = X8_XOR(nlfsr[loc_b], a); \
+    d = X8_XOR(nlfsr[loc_d], c); \
+    f = X8_XOR(X8_XOR(nlfsr[loc_e+1], e), c2); \
+    c2 = X8_ADD(c2, _mm256_set1_epi32(1)); \
+    c1 = _mm256_sub_epi32(c1, _mm256_cmpeq_epi32(c2, _mm256_setzero_si256())); \
+    c = X8_ADD(c, b); \
+    e = X8_ADD(e, d); \
+    a = X8_ADD(a, f); \
+    f = X8_XOR(f, X8_G2(c)); b = X8_XOR(b, X8_G3(e)); d = X8_XOR(d, X8_G1(a)); \
+    e = X8_XOR(e, X8_H3(f)); a = X8_XOR(a, X8_H1(b)); c = X8_XOR(c, X8_H2(d)); \
+    nlfsr[loc_fb1] = X8_ADD(b, e); \
+    nlfsr[loc_fb1+1] = X8_XOR(c, nlfsr[loc_fb1]); \
+    *(out++) = X8_XOR(a, X8_ADD(f, c)); \
+    *(out++) = X8_XOR(e, X8_ADD(d, a));
+
+/**
+ * X8_MIX is one IV mixing stage (DRAGON_UPDATE) at ring offset o on
+ * 8 transposed NLFSRs; see DRAGON_16MIX.
+ */
+#define X8_MIX(nlfsr, a, b, c, d, e, f, o) \
+    a = X8_XOR(X8_XOR(nlfsr[o], nlfsr[((o) + 24) & 31]), nlfsr[((o) + 28) & 31]); \
+    b = X8_XOR(X8_XOR(nlfsr[(o) + 1], nlfsr[((o) + 25) & 31]), nlfsr[((o) + 29) & 31]); \
+    c = X8_XOR(X8_XOR(nlfsr[(o) + 2], nlfsr[((o) + 26) & 31]), nlfsr[((o) + 30) & 31]); \
+    d = X8_XOR(X8_XOR(nlfsr[(o) + 3], nlfsr[((o) + 27) & 31]), nlfsr[((o) + 31) & 31]); \
+    b = X8_XOR(b, a); d = X8_XOR(d, c); f = X8_XOR(f, e); \
+    c = X8_ADD(c, b); e = X8_ADD(e, d); a = X8_ADD(a, f); \
+    f = X8_XOR(f, X8_G2(c)); b = X8_XOR(b, X8_G3(e)); d = X8_XOR(d, X8_G1(a)); \
+    e = X8_XOR(e, X8_H3(f)); a = X8_XOR(a, X8_H1(b)); c = X8_XOR(c, X8_H2(d)); \
+    b = X8_ADD(b, e); d = X8_ADD(d, a); f = X8_ADD(f, c); \
+    c = X8_XOR(c, b); e = X8_XOR(e, d); a = X8_XOR(a, f); \
+    nlfsr[((o) + 28) & 31] = X8_XOR(a, nlfsr[((o) + 16) & 31]); \
+    nlfsr[((o) + 29) & 31] = X8_XOR(b, nlfsr[((o) + 17) & 31]); \
+    nlfsr[((o) + 30) & 31] = X8_XOR(c, nlfsr[((o) + 18) & 31]); \
+    nlfsr[((o) + 31) & 31] = X8_XOR(d, nlfsr[((o) + 19) & 31]);
+
+/**
+ * In-place transpose of an 8x8 matrix of 32-bit words.
+ */
+static inline void dragon_transpose8(__m256i r[8])
+{
+    __m256i t0, t1, t2, t3, t4, t5, t6, t7;
+    __m256i u0, u1, u2, u3, u4, u5, u6, u7;
+
+    t0 = _mm256_unpacklo_epi32(r[0], r[1]);
+    t1 = _mm256_unpackhi_epi32(r[0], r[1]);
+    t2 = _mm256_unpacklo_epi32(r[2], r[3]);
+    t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+    t4 = _mm256_unpacklo_epi32(r[4], r[5]);
+    t5 = _mm256_unpackhi_epi32(r[4], r[5]);
+    t6 = _mm256_unpacklo_epi32(r[6], r[7]);
+    t7 = _mm256_unpackhi_epi32(r[6], r[7]);
+
+    u0 = _mm256_unpacklo_epi64(t0, t2);
+    u1 = _mm256_unpackhi_epi64(t0, t2);
+    u2 = _mm256_unpacklo_epi64(t1, t3);
+    u3 = _mm256_unpackhi_epi64(t1, t3);
+    u4 = _mm256_unpacklo_epi64(t4, t6);
+    u5 = _mm256_unpackhi_epi64(t4, t6);
+    u6 = _mm256_unpacklo_epi64(t5, t7);
+    u7 = _mm256_unpackhi_epi64(t5, t7);
+
+    r[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+    r[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+    r[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+    r[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+    r[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+    r[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+    r[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+    r[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+/**
+ * Run #(blocks) rounds on 8 streams. The keystream is written in
+ * big-endian byte order to output[lane], XORed with input[lane] unless
+ * input is NULL.
+ */
+static void dragon_x8_blocks(
+  ECRYPT_ctx** ctx,
+  const u8** input,
+  u8** output,
+  u32 blocks)
+{
+    __m256i nlfsr[DRAGON_NLFSR_SIZE];
+    __m256i ks[2 * 16];
+    __m256i row[DRAGON_AVX2_LANES];
+    __m256i a, b, c, d, e, f;
+    __m256i c1, c2;
+    __m256i *k_ptr;
+    const __m256i bswap = _mm256_setr_epi8(
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    u32 done = 0;
+    u32 lane, q;
+
+    assert(blocks % 16 == 0);
+
+    /* transpose the 8 NLFSRs into lane order */
+    for (q = 0; q < DRAGON_NLFSR_SIZE / 8; q++) {
+        for (lane = 0; lane < DRAGON_AVX2_LANES; lane++) {
+            row[lane] = _mm256_loadu_si256(
+                (const __m256i*)(ctx[lane]->nlfsr_word + 8 * q));
+        }
+        dragon_transpose8(row);
+        for (lane = 0; lane < 8; lane++) {
+            nlfsr[8 * q + lane] = row[lane];
+        }
+    }
+    c1 = _mm256_setr_epi32(
+        ctx[0]->state_counter[0], ctx[1]->state_counter[0],
+        ctx[2]->state_counter[0], ctx[3]->state_counter[0],
+        ctx[4]->state_counter[0], ctx[5]->state_counter[0],
+        ctx[6]->state_counter[0], ctx[7]->state_counter[0]);
+    c2 = _mm256_setr_epi32(
+        ctx[0]->state_counter[1], ctx[1]->state_counter[1],
+        ctx[2]->state_counter[1], ctx[3]->state_counter[1],
+        ctx[4]->state_counter[1], ctx[5]->state_counter[1],
+        ctx[6]->state_counter[1], ctx[7]->state_counter[1]);
+
+    while (done < blocks) {
+        k_ptr = ks;
+        DRAGON_16RND(X8_RND, nlfsr, a, b, c, d, e, f, c1, c2, in, k_ptr)
+
+        /* ks[i] holds keystream word i of every lane; each 8x8
+           transpose yields 32 contiguous bytes per lane */
+        for (q = 0; q < 4; q++) {
+            for (lane = 0; lane < 8; lane++) {
+                row[lane] = ks[8 * q + lane];
+            }
+            dragon_transpose8(row);
+            for (lane = 0; lane < DRAGON_AVX2_LANES; lane++) {
+                size_t pos = (size_t)done * 8 + q * 32;
+
+                row[lane] = _mm256_shuffle_epi8(row[lane], bswap);
+                if (input) {
+                    row[lane] = X8_XOR(row[lane], _mm256_loadu_si256(
+                        (const __m256i*)(input[lane] + pos)));
+                }
+                _mm256_storeu_si256((__m256i*)(output[lane] + pos), row[lane]);
+            }
+        }
+        done += 16;
+    }
+
+    for (q = 0; q < DRAGON_NLFSR_SIZE / 8; q++) {
+        for (lane = 0; lane < 8; lane++) {
+            row[lane] = nlfsr[8 * q + lane];
+        }
+        dragon_transpose8(row);
+        for (lane = 0; lane < DRAGON_AVX2_LANES; lane++) {
+            _mm256_storeu_si256(
+                (__m256i*)(ctx[lane]->nlfsr_word + 8 * q), row[lane]);
+        }
+    }
+    for (lane = 0; lane < DRAGON_AVX2_LANES; lane++) {
+        ctx[lane]->state_counter[0] = ((const u32*)&c1)[lane];
+        ctx[lane]->state_counter[1] = ((const u32*)&c2)[lane];
+    }
+}
+
+/**
+ * Generate #(blocks) 64-bit blocks of keystream for each of 8 streams.
+ * @param  ctx        [In/Out]  8 distinct Dragon contexts
+ * @param  keystream  [Out]     8 pre-allocated arrays of 8*(blocks) bytes
+ * @param  blocks     [In]      number of keystream blocks per stream,
+ *                              a multiple of 16
+ */
+void DRAGON_keystream_blocks_x8(
+  ECRYPT_ctx* ctx[DRAGON_AVX2_LANES],
+  u8* keystream[DRAGON_AVX2_LANES],
+  u32 blocks)
+{
+    assert(ctx && keystream);
+
+    dragon_x8_blocks(ctx, NULL, keystream, blocks);
+}
+
+/**
+ * Encrypt/Decrypt #(blocks) 64-bit blocks of text for each of 8 streams.
+ * @param  action  [In]      This parameter has no meaning for Dragon
+ * @param  ctx     [In/Out]  8 distinct Dragon contexts
+ * @param  input   [In]      8 arrays of (plain/cipher)text blocks
+ * @param  output  [Out]     8 pre-allocated arrays of 8*(blocks) bytes
+ * @param  blocks  [In]      number of blocks per stream, a multiple of 16
+ */
+void DRAGON_process_blocks_x8(
+  int action,                 /* 0 = encrypt; 1 = decrypt; */
+  ECRYPT_ctx* ctx[DRAGON_AVX2_LANES],
+  const u8* input[DRAGON_AVX2_LANES],
+  u8* output[DRAGON_AVX2_LANES],
+  u32 blocks)
+{
+    assert(ctx && input && output);
+
+    dragon_x8_blocks(ctx, input, output, blocks);
+}
+
+/**
+ * IV setup of up to 8 streams: the IVs are injected per stream, then
+ * the 16 mixing stages run on all NLFSRs at once.
+ * @param  ctx  [In/Out]  8 distinct Dragon contexts after
+ *                        ECRYPT_keysetup(), NULL for idle lanes
+ * @param  iv   [In]      8 IVs
+ */
+void DRAGON_ivsetup_x8(
+  ECRYPT_ctx* ctx[DRAGON_AVX2_LANES],
+  const u8* iv[DRAGON_AVX2_LANES])
+{
+    __m256i nlfsr[DRAGON_NLFSR_SIZE];
+    __m256i row[DRAGON_AVX2_LANES];
+    __m256i a, b, c, d, e, f;
+    u32 ctr[2][DRAGON_AVX2_LANES];
+    u32 lane, q;
+
+    assert(ctx && iv);
+
+    for (lane = 0; lane < DRAGON_AVX2_LANES; lane++) {
+        if (ctx[lane]) {
+            assert(iv[lane]);
+            dragon_iv_load(ctx[lane], iv[lane]);
+        }
+    }
+
+    for (q = 0; q < DRAGON_NLFSR_SIZE / 8; q++) {
+        for (lane = 0; lane < DRAGON_AVX2_LANES; lane++) {
+            row[lane] = ctx[lane] ? _mm256_loadu_si256(
+                (const __m256i*)(ctx[lane]->nlfsr_word + 8 * q))
+                : _mm256_setzero_si256();
+        }
+        dragon_transpose8(row);
+        for (lane = 0; lane < 8; lane++) {
+            nlfsr[8 * q + lane] = row[lane];
+        }
+    }
+    e = _mm256_set1_epi32(DRAGON_MIX_E);
+    f = _mm256_set1_epi32(DRAGON_MIX_F);
+
+    DRAGON_16MIX(X8_MIX, nlfsr, a, b, c, d, e, f)
+
+    for (q = 0; q < DRAGON_NLFSR_SIZE / 8; q++) {
+        for (lane = 0; lane < 8; lane++) {
+            row[lane] = nlfsr[8 * q + lane];
+        }
+        dragon_transpose8(row);
+        for (lane = 0; lane < DRAGON_AVX2_LANES; lane++) {
+            if (ctx[lane]) {
+                _mm256_storeu_si256(
+                    (__m256i*)(ctx[lane]->nlfsr_word + 8 * q), row[lane]);
+            }
+        }
+    }
+    _mm256_storeu_si256((__m256i*)ctr[0], e);
+    _mm256_storeu_si256((__m256i*)ctr[1], f);
+    for (lane = 0; lane < DRAGON_AVX2_LANES; lane++) {
+        if (ctx[lane]) {
+            dragon_iv_done(ctx[lane], ctr[0][lane], ctr[1][lane]);
+        }
+    }
+}
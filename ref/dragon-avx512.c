@@ -0,0 +1,523 @@
+/**
+ * @file dragon-avx512.c
+ * AVX-512 implementation of Dragon, 16 streams in lockstep
+ * This source is provided without warranty
+ * or guarantee of any kind. Use at your own risk.
+ */
+#include <assert.h>
+#include <immintrin.h>
+
+#include "dragon-dispatch.h"
+#include "dragon-sboxes.c"
+#include "dragon-schedule.h"
+
+/**
+ * Each of the 16 32-bit lanes of a vector holds the corresponding word
+ * of a different stream. The virtual 32x32 s-boxes are evaluated by a
+ * lookup method L(s, x, n), passed down to the G/H, round and mixing
+ * macros: X16_GATHER uses one gather per byte position; X16_SELECT
+ * uses, when perm is set, register-resident copies of the s-boxes
+ * sbox1_zmm/sbox2_zmm (see dragon_permute16), and gathers otherwise.
+ */
+#define X16_BYTE(x, n) \
+    _mm512_and_epi32(_mm512_srli_epi32(x, 8 * (n)), _mm512_set1_epi32(0xFF))
+
+#define X16_GATHER(s, x, n) \
+    _mm512_i32gather_epi32(X16_BYTE(x, n), (const void*)s, 4)
+
+#define X16_SELECT(s, x, n) \
+    (perm ? dragon_permute16(s##_zmm, _mm512_srli_epi32(x, 8 * (n))) \
+          : X16_GATHER(s, x, n))
+
+#define X16_SBOX(L, s0, s1, s2, s3, x) \
+    _mm512_xor_epi32( \
+      _mm512_xor_epi32(L(s0, x, 0), L(s1, x, 1)), \
+      _mm512_xor_epi32(L(s2, x, 2), L(s3, x, 3)))
+
+#define X16_G1(L, x) X16_SBOX(L, sbox2, sbox1, sbox1, sbox1, x)
+#define X16_G2(L, x) X16_SBOX(L, sbox1, sbox2, sbox1, sbox1, x)
+#define X16_G3(L, x) X16_SBOX(L, sbox1, sbox1, sbox2, sbox1, x)
+#define X16_H1(L, x) X16_SBOX(L, sbox1, sbox2, sbox2, sbox2, x)
+#define X16_H2(L, x) X16_SBOX(L, sbox2, sbox1, sbox2, sbox2, x)
+#define X16_H3(L, x) X16_SBOX(L, sbox2, sbox2, sbox1, sbox2, x)
+
+/* The G and H layers shared by X16_RND and X16_MIX */
+#define X16_GH(L, a, b, c, d, e, f) \
+    f = X16_XOR(f, X16_G2(L, c)); b = X16_XOR(b, X16_G3(L, e)); d = X16_XOR(d, X16_G1(L, a)); \
+    e = X16_XOR(e, X16_H3(L, f)); a = X16_XOR(a, X16_H1(L, b)); c = X16_XOR(c, X16_H2(L, d));
+
+#define X16_XOR(x, y) _mm512_xor_epi32(x, y)
+#define X16_ADD(x, y) _mm512_add_epi32(x, y)
+
+/**
+ * X16_RND is BASIC_RND applied to 16 transposed NLFSRs. Only the lanes
+ * selected by the mask m have their NLFSR and counter advanced; idle
+ * lanes compute garbage that is never stored. The 64-bit counter carry
+ * is propagated per block.
+ */
+#define X16_RND(L, nlfsr, a, loc_a, b, loc_b, c, loc_c, \
+                       d, loc_d, e, loc_e, f, loc_fb1, c1, c2, m, out) \
+    a = nlfsr[loc_a]; \
+    c = nlfsr[loc_c]; \
+    e = X16_XOR(nlfsr[loc_e], c1); \
+    b = X16_XOR(nlfsr[loc_b], a); \
+    d = X16_XOR(nlfsr[loc_d], c); \
+    f = X16_XOR(X16_XOR(nlfsr[loc_e+1], e), c2); \
+    c2 = _mm512_mask_add_epi32(c2, m, c2, _mm512_set1_epi32(1)); \
+    c1 = _mm512_mask_add_epi32(c1, \
+        _mm512_mask_cmpeq_epi32_mask(m, c2, _mm512_setzero_si512()), \
+        c1, _mm512_set1_epi32(1)); \
+    c = X16_ADD(c, b); \
+    e = X16_ADD(e, d); \
+    a = X16_ADD(a, f); \
+    X16_GH(L, a, b, c, d, e, f) \
+    nlfsr[loc_fb1] = _mm512_mask_mov_epi32(nlfsr[loc_fb1], m, X16_ADD(b, e)); \
+    nlfsr[loc_fb1+1] = _mm512_mask_mov_epi32(nlfsr[loc_fb1+1], m, \
+        X16_XOR(c, X16_ADD(b, e))); \
+    *(out++) = X16_XOR(a, X16_ADD(f, c)); \
+    *(out++) = X16_XOR(e, X16_ADD(d, a));
+
+#define X16_RND_SELECT(...) X16_RND(X16_SELECT, __VA_ARGS__)
+
+/**
+ * X16_MIX is one IV mixing stage (DRAGON_UPDATE) at ring offset o on
+ * 16 transposed NLFSRs; see DRAGON_16MIX.
+ */
+#define X16_MIX(L, nlfsr, a, b, c, d, e, f, o) \
+    a = X16_XOR(X16_XOR(nlfsr[o], nlfsr[((o) + 24) & 31]), nlfsr[((o) + 28) & 31]); \
+    b = X16_XOR(X16_XOR(nlfsr[(o) + 1], nlfsr[((o) + 25) & 31]), nlfsr[((o) + 29) & 31]); \
+    c = X16_XOR(X16_XOR(nlfsr[(o) + 2], nlfsr[((o) + 26) & 31]), nlfsr[((o) + 30) & 31]); \
+    d = X16_XOR(X16_XOR(nlfsr[(o) + 3], nlfsr[((o) + 27) & 31]), nlfsr[((o) + 31) & 31]); \
+    b = X16_XOR(b, a); d = X16_XOR(d, c); f = X16_XOR(f, e); \
+    c = X16_ADD(c, b); e = X16_ADD(e, d); a = X16_ADD(a, f); \
+    X16_GH(L, a, b, c, d, e, f) \
+    b = X16_ADD(b, e); d = X16_ADD(d, a); f = X16_ADD(f, c); \
+    c = X16_XOR(c, b); e = X16_XOR(e, d); a = X16_XOR(a, f); \
+    nlfsr[((o) + 28) & 31] = X16_XOR(a, nlfsr[((o) + 16) & 31]); \
+    nlfsr[((o) + 29) & 31] = X16_XOR(b, nlfsr[((o) + 17) & 31]); \
+    nlfsr[((o) + 30) & 31] = X16_XOR(c, nlfsr[((o) + 18) & 31]); \
+    nlfsr[((o) + 31) & 31] = X16_XOR(d, nlfsr[((o) + 19) & 31]);
+
+#define X16_MIX_GATHER(...) X16_MIX(X16_GATHER, __VA_ARGS__)
+
+/**
+ * Look up 16 s-box entries held in 16 zmm registers. vpermi2d selects
+ * among 32 entries using the low 5 index bits; index bits 5-7 then pick
+ * one of the eight candidates in three blend stages. Only the low 8
+ * bits of each index are used. There are no memory accesses, so the
+ * lookup time does not depend on the index.
+ */
+static inline __m512i dragon_permute16(const __m512i t[16], __m512i idx)
+{
+    __m512i r0, r1, r2, r3, r4, r5, r6, r7;
+    __mmask16 m;
+
+    r0 = _mm512_permutex2var_epi32(t[0],  idx, t[1]);
+    r1 = _mm512_permutex2var_epi32(t[2],  idx, t[3]);
+    r2 = _mm512_permutex2var_epi32(t[4],  idx, t[5]);
+    r3 = _mm512_permutex2var_epi32(t[6],  idx, t[7]);
+    r4 = _mm512_permutex2var_epi32(t[8],  idx, t[9]);
+    r5 = _mm512_permutex2var_epi32(t[10], idx, t[11]);
+    r6 = _mm512_permutex2var_epi32(t[12], idx, t[13]);
+    r7 = _mm512_permutex2var_epi32(t[14], idx, t[15]);
+
+    m  = _mm512_test_epi32_mask(idx, _mm512_set1_epi32(0x20));
+    r0 = _mm512_mask_blend_epi32(m, r0, r1);
+    r2 = _mm512_mask_blend_epi32(m, r2, r3);
+    r4 = _mm512_mask_blend_epi32(m, r4, r5);
+    r6 = _mm512_mask_blend_epi32(m, r6, r7);
+
+    m  = _mm512_test_epi32_mask(idx, _mm512_set1_epi32(0x40));
+    r0 = _mm512_mask_blend_epi32(m, r0, r2);
+    r4 = _mm512_mask_blend_epi32(m, r4, r6);
+
+    m  = _mm512_test_epi32_mask(idx, _mm512_set1_epi32(0x80));
+    return _mm512_mask_blend_epi32(m, r0, r4);
+}
+
+/**
+ * Byte swap of every 32-bit word using AVX-512F rotates only.
+ */
+static inline __m512i dragon_bswap16(__m512i x)
+{
+    const __m512i even = _mm512_set1_epi32(0x00FF00FF);
+
+    return _mm512_or_epi32(
+        _mm512_and_epi32(_mm512_rol_epi32(x, 8), even),
+        _mm512_andnot_epi32(even, _mm512_ror_epi32(x, 8)));
+}
+
+/**
+ * In-place transpose of a 16x16 matrix of 32-bit words.
+ */
+static inline void dragon_transpose16(__m512i r[16])
+{
+    __m512i t[16], u[16], x0, x1, y0, y1;
+    int i, j;
+
+    for (i = 0; i < 8; i++) {
+        t[2*i]   = _mm512_unpacklo_epi32(r[2*i], r[2*i+1]);
+        t[2*i+1] = _mm512_unpackhi_epi32(r[2*i], r[2*i+1]);
+    }
+    for (i = 0; i < 4; i++) {
+        u[4*i]   = _mm512_unpacklo_epi64(t[4*i],   t[4*i+2]);
+        u[4*i+1] = _mm512_unpackhi_epi64(t[4*i],   t[4*i+2]);
+        u[4*i+2] = _mm512_unpacklo_epi64(t[4*i+1], t[4*i+3]);
+        u[4*i+3] = _mm512_unpackhi_epi64(t[4*i+1], t[4*i+3]);
+    }
+    /* u[j] holds, in 128-bit lane k, column 4k+j of rows 0..3 */
+    for (j = 0; j < 4; j++) {
+        x0 = _mm512_shuffle_i32x4(u[j],   u[4+j],  0x88);
+        x1 = _mm512_shuffle_i32x4(u[j],   u[4+j],  0xDD);
+        y0 = _mm512_shuffle_i32x4(u[8+j], u[12+j], 0x88);
+        y1 = _mm512_shuffle_i32x4(u[8+j], u[12+j], 0xDD);
+        r[j]    = _mm512_shuffle_i32x4(x0, y0, 0x88);
+        r[4+j]  = _mm512_shuffle_i32x4(x1, y1, 0x88);
+        r[8+j]  = _mm512_shuffle_i32x4(x0, y0, 0xDD);
+        r[12+j] = _mm512_shuffle_i32x4(x1, y1, 0xDD);
+    }
+}
+
+/**
+ * Run 16 transposed NLFSRs for count[lane] rounds each; lanes with a
+ * count of 0 stay idle. The keystream is written in big-endian byte
+ * order to output[lane], XORed with input[lane] unless input is NULL.
+ * perm selects the s-box lookup method and is a constant at every call
+ * site, so each caller gets its own specialised copy.
+ */
+static inline __attribute__((always_inline)) void dragon_x16_run(
+  __m512i nlfsr[DRAGON_NLFSR_SIZE],
+  __m512i* counter1,
+  __m512i* counter2,
+  const u8** input,
+  u8** output,
+  const u32* count,
+  const int perm)
+{
+    __m512i sbox1_zmm[16], sbox2_zmm[16];
+    __m512i ks[2 * 16];
+    __m512i row[DRAGON_AVX512_LANES];
+    __m512i a, b, c, d, e, f;
+    __m512i c1 = *counter1, c2 = *counter2;
+    __m512i remaining;
+    __m512i *k_ptr;
+    __mmask16 m;
+    u32 done = 0;
+    u32 lane, q, h;
+
+    if (perm) {
+        for (q = 0; q < 16; q++) {
+            sbox1_zmm[q] = _mm512_loadu_si512(sbox1 + 16 * q);
+            sbox2_zmm[q] = _mm512_loadu_si512(sbox2 + 16 * q);
+        }
+    }
+    remaining = _mm512_loadu_si512(count);
+
+    while ((m = _mm512_cmpgt_epu32_mask(remaining, _mm512_set1_epi32(done)))) {
+        k_ptr = ks;
+        DRAGON_16RND(X16_RND_SELECT, nlfsr, a, b, c, d, e, f, c1, c2, m, k_ptr)
+
+        /* ks[i] holds keystream word i of every lane; each 16x16
+           transpose yields 64 contiguous bytes per lane */
+        for (h = 0; h < 2; h++) {
+            for (lane = 0; lane < 16; lane++) {
+                row[lane] = dragon_bswap16(ks[16 * h + lane]);
+            }
+            dragon_transpose16(row);
+            for (lane = 0; lane < DRAGON_AVX512_LANES; lane++) {
+                size_t pos = (size_t)done * 8 + h * 64;
+
+                if (!(m >> lane & 1)) {
+                    continue;
+                }
+                if (input) {
+                    row[lane] = X16_XOR(row[lane],
+                        _mm512_loadu_si512(input[lane] + pos));
+                }
+                _mm512_storeu_si512(output[lane] + pos, row[lane]);
+            }
+        }
+        done += 16;
+    }
+    *counter1 = c1;
+    *counter2 = c2;
+}
+
+/**
+ * Run up to 16 streams for blocks[lane] rounds each. Lanes whose
+ * context is NULL or whose count is 0 stay idle.
+ */
+static inline __attribute__((always_inline)) void dragon_x16_blocks(
+  ECRYPT_ctx** ctx,
+  const u8** input,
+  u8** output,
+  const u32* blocks,
+  const int perm)
+{
+    __m512i nlfsr[DRAGON_NLFSR_SIZE];
+    __m512i row[DRAGON_AVX512_LANES];
+    __m512i c1, c2;
+    u32 ctr[2][DRAGON_AVX512_LANES];
+    u32 count[DRAGON_AVX512_LANES];
+    __mmask16 active;
+    u32 lane, q;
+
+    active = 0;
+    for (lane = 0; lane < DRAGON_AVX512_LANES; lane++) {
+        count[lane] = ctx[lane] ? blocks[lane] : 0;
+        assert(count[lane] % 16 == 0);
+        if (count[lane]) {
+            active |= (__mmask16)(1u << lane);
+        }
+        ctr[0][lane] = count[lane] ? ctx[lane]->state_counter[0] : 0;
+        ctr[1][lane] = count[lane] ? ctx[lane]->state_counter[1] : 0;
+    }
+    if (!active) {
+        return;
+    }
+
+    /* transpose the NLFSRs into lane order */
+    for (q = 0; q < DRAGON_NLFSR_SIZE / 16; q++) {
+        for (lane = 0; lane < DRAGON_AVX512_LANES; lane++) {
+            row[lane] = _mm512_maskz_loadu_epi32(
+                (active >> lane & 1) ? 0xFFFF : 0,
+                ctx[lane] ? ctx[lane]->nlfsr_word + 16 * q : NULL);
+        }
+        dragon_transpose16(row);
+        for (lane = 0; lane < 16; lane++) {
+            nlfsr[16 * q + lane] = row[lane];
+        }
+    }
+    c1 = _mm512_loadu_si512(ctr[0]);
+    c2 = _mm512_loadu_si512(ctr[1]);
+
+    dragon_x16_run(nlfsr, &c1, &c2, input, output, count, perm);
+
+    for (q = 0; q < DRAGON_NLFSR_SIZE / 16; q++) {
+        for (lane = 0; lane < 16; lane++) {
+            row[lane] = nlfsr[16 * q + lane];
+        }
+        dragon_transpose16(row);
+        for (lane = 0; lane < DRAGON_AVX512_LANES; lane++) {
+            if (active >> lane & 1) {
+                _mm512_storeu_si512(ctx[lane]->nlfsr_word + 16 * q, row[lane]);
+            }
+        }
+    }
+    _mm512_storeu_si512(ctr[0], c1);
+    _mm512_storeu_si512(ctr[1], c2);
+    for (lane = 0; lane < DRAGON_AVX512_LANES; lane++) {
+        if (active >> lane & 1) {
+            ctx[lane]->state_counter[0] = ctr[0][lane];
+            ctx[lane]->state_counter[1] = ctr[1][lane];
+        }
+    }
+}
+
+/**
+ * Run the 16 streams held in structure-of-arrays form at nlfsr (word j
+ * of lane l at nlfsr[j * stride + l]) and counter[0..1][l], for blocks
+ * rounds each. Only the lanes in active are read, run and written
+ * back. No transposes are needed.
+ */
+static inline __attribute__((always_inline)) void dragon_x16_soa(
+  u32* nlfsr_soa,
+  u32 stride,
+  u32* counter1,
+  u32* counter2,
+  __mmask16 active,
+  const u8** input,
+  u8** output,
+  u32 blocks,
+  const int perm)
+{
+    __m512i nlfsr[DRAGON_NLFSR_SIZE];
+    __m512i c1, c2;
+    u32 count[DRAGON_AVX512_LANES];
+    u32 lane, j;
+
+    assert(blocks % 16 == 0);
+
+    for (lane = 0; lane < DRAGON_AVX512_LANES; lane++) {
+        count[lane] = (active >> lane & 1) ? blocks : 0;
+    }
+    for (j = 0; j < DRAGON_NLFSR_SIZE; j++) {
+        nlfsr[j] = _mm512_maskz_loadu_epi32(active, nlfsr_soa + j * stride);
+    }
+    c1 = _mm512_maskz_loadu_epi32(active, counter1);
+    c2 = _mm512_maskz_loadu_epi32(active, counter2);
+
+    dragon_x16_run(nlfsr, &c1, &c2, input, output, count, perm);
+
+    for (j = 0; j < DRAGON_NLFSR_SIZE; j++) {
+        _mm512_mask_storeu_epi32(nlfsr_soa + j * stride, active, nlfsr[j]);
+    }
+    _mm512_mask_storeu_epi32(counter1, active, c1);
+    _mm512_mask_storeu_epi32(counter2, active, c2);
+}
+
+void dragon_x16_soa_blocks(
+  u32* nlfsr,
+  u32 stride,
+  u32* counter1,
+  u32* counter2,
+  u32 active,
+  const u8** input,
+  u8** output,
+  u32 blocks)
+{
+    dragon_x16_soa(nlfsr, stride, counter1, counter2, (__mmask16)active,
+                   input, output, blocks, 0);
+}
+
+void dragon_x16_soa_blocks_perm(
+  u32* nlfsr,
+  u32 stride,
+  u32* counter1,
+  u32* counter2,
+  u32 active,
+  const u8** input,
+  u8** output,
+  u32 blocks)
+{
+    dragon_x16_soa(nlfsr, stride, counter1, counter2, (__mmask16)active,
+                   input, output, blocks, 1);
+}
+
+/**
+ * Generate blocks[lane] 64-bit blocks of keystream for each of 16 streams.
+ * @param  ctx        [In/Out]  16 distinct Dragon contexts, NULL for
+ *                              idle lanes
+ * @param  keystream  [Out]     16 pre-allocated arrays of
+ *                              8*(blocks[lane]) bytes
+ * @param  blocks     [In]      number of keystream blocks per stream,
+ *                              each a multiple of 16
+ */
+void DRAGON_keystream_blocks_x16(
+  ECRYPT_ctx* ctx[DRAGON_AVX512_LANES],
+  u8* keystream[DRAGON_AVX512_LANES],
+  const u32 blocks[DRAGON_AVX512_LANES])
+{
+    assert(ctx && keystream && blocks);
+
+    dragon_x16_blocks(ctx, NULL, keystream, blocks, 0);
+}
+
+/**
+ * Encrypt/Decrypt blocks[lane] 64-bit blocks of text for each of 16
+ * streams.
+ * @param  action  [In]      This parameter has no meaning for Dragon
+ * @param  ctx     [In/Out]  16 distinct Dragon contexts, NULL for idle lanes
+ * @param  input   [In]      16 arrays of (plain/cipher)text blocks
+ * @param  output  [Out]     16 pre-allocated arrays of 8*(blocks[lane]) bytes
+ * @param  blocks  [In]      number of blocks per stream, each a multiple
+ *                           of 16
+ */
+void DRAGON_process_blocks_x16(
+  int action,                 /* 0 = encrypt; 1 = decrypt; */
+  ECRYPT_ctx* ctx[DRAGON_AVX512_LANES],
+  const u8* input[DRAGON_AVX512_LANES],
+  u8* output[DRAGON_AVX512_LANES],
+  const u32 blocks[DRAGON_AVX512_LANES])
+{
+    assert(ctx && input && output && blocks);
+
+    dragon_x16_blocks(ctx, input, output, blocks, 0);
+}
+
+/**
+ * Same as DRAGON_keystream_blocks_x16(), with the s-boxes resolved in
+ * registers instead of gathered from memory.
+ */
+void DRAGON_keystream_blocks_x16_perm(
+  ECRYPT_ctx* ctx[DRAGON_AVX512_LANES],
+  u8* keystream[DRAGON_AVX512_LANES],
+  const u32 blocks[DRAGON_AVX512_LANES])
+{
+    assert(ctx && keystream && blocks);
+
+    dragon_x16_blocks(ctx, NULL, keystream, blocks, 1);
+}
+
+/**
+ * Same as DRAGON_process_blocks_x16(), with the s-boxes resolved in
+ * registers instead of gathered from memory.
+ */
+void DRAGON_process_blocks_x16_perm(
+  int action,                 /* 0 = encrypt; 1 = decrypt; */
+  ECRYPT_ctx* ctx[DRAGON_AVX512_LANES],
+  const u8* input[DRAGON_AVX512_LANES],
+  u8* output[DRAGON_AVX512_LANES],
+  const u32 blocks[DRAGON_AVX512_LANES])
+{
+    assert(ctx && input && output && blocks);
+
+    dragon_x16_blocks(ctx, input, output, blocks, 1);
+}
+
+/**
+ * IV setup of up to 16 streams: the IVs are injected per stream, then
+ * the 16 mixing stages run on all NLFSRs at once.
+ * @param  ctx  [In/Out]  16 distinct Dragon contexts after
+ *                        ECRYPT_keysetup(), NULL for idle lanes
+ * @param  iv   [In]      16 IVs
+ */
+void DRAGON_ivsetup_x16(
+  ECRYPT_ctx* ctx[DRAGON_AVX512_LANES],
+  const u8* iv[DRAGON_AVX512_LANES])
+{
+    __m512i nlfsr[DRAGON_NLFSR_SIZE];
+    __m512i row[DRAGON_AVX512_LANES];
+    __m512i a, b, c, d, e, f;
+    u32 ctr[2][DRAGON_AVX512_LANES];
+    __mmask16 active = 0;
+    u32 lane, q;
+
+    assert(ctx && iv);
+
+    for (lane = 0; lane < DRAGON_AVX512_LANES; lane++) {
+        if (ctx[lane]) {
+            assert(iv[lane]);
+            dragon_iv_load(ctx[lane], iv[lane]);
+            active |= (__mmask16)(1u << lane);
+        }
+    }
+    if (!active) {
+        return;
+    }
+
+    for (q = 0; q < DRAGON_NLFSR_SIZE / 16; q++) {
+        for (lane = 0; lane < DRAGON_AVX512_LANES; lane++) {
+            row[lane] = _mm512_maskz_loadu_epi32(
+                (active >> lane & 1) ? 0xFFFF : 0,
+                ctx[lane] ? ctx[lane]->nlfsr_word + 16 * q : NULL);
+        }
+        dragon_transpose16(row);
+        for (lane = 0; lane < 16; lane++) {
+            nlfsr[16 * q + lane] = row[lane];
+        }
+    }
+    e = _mm512_set1_epi32(DRAGON_MIX_E);
+    f = _mm512_set1_epi32(DRAGON_MIX_F);
+
+    DRAGON_16MIX(X16_MIX_GATHER, nlfsr, a, b, c, d, e, f)
+
+    for (q = 0; q < DRAGON_NLFSR_SIZE / 16; q++) {
+        for (lane = 0; lane < 16; lane++) {
+            row[lane] = nlfsr[16 * q + lane];
+        }
+        dragon_transpose16(row);
+        for (lane = 0; lane < DRAGON_AVX512_LANES; lane++) {
+            if (active >> lane & 1) {
+                _mm512_storeu_si512(ctx[lane]->nlfsr_word + 16 * q, row[lane]);
+            }
+        }
+    }
+    _mm512_storeu_si512(ctr[0], e);
+    _mm512_storeu_si512(ctr[1], f);
+    for (lane = 0; lane < DRAGON_AVX512_LANES; lane++) {
+        if (active >> lane & 1) {
+            dragon_iv_done(ctx[lane], ctr[0][lane], ctr[1][lane]);
+        }
+    }
+}
@@ -0,0 +1,362 @@
+/**
+ * @file dragon-bank.c
+ * Structure-of-arrays bank of Dragon streams
+ * This source is provided without warranty
+ * or guarantee of any kind. Use at your own risk.
+ */
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dragon-bank.h"
+#include "dragon-dispatch.h"
+
+#define DRAGON_BANK_LANES  16  /* slots per kernel call */
+#define DRAGON_BANK_ALIGN  64  /* row alignment in bytes */
+
+/**
+ * Word j of the NLFSR of slot s is at nlfsr[j * capacity + s], the
+ * counter halves at counter[s] and counter[capacity + s]. Freed slots
+ * below top are kept on a stack and reused first.
+ */
+struct dragon_bank
+{
+    u32* nlfsr;
+    u32* counter;
+    u32* generation;
+    u8*  live;
+    u32* free_slot;
+    u32  capacity;
+    u32  top;                 /* slots at or above top were never used */
+    u32  free_count;
+    u32  live_count;
+};
+
+/*
+ * Zero memory in a way the compiler may not elide.
+ */
+static void dragon_wipe(void* p, size_t n)
+{
+    volatile u8* v = (volatile u8*)p;
+
+    while (n--) {
+        *v++ = 0;
+    }
+}
+
+static int dragon_bank_valid(const dragon_bank* bank, dragon_slot handle)
+{
+    return handle.slot < bank->top && bank->live[handle.slot] &&
+           bank->generation[handle.slot] == handle.generation;
+}
+
+static void dragon_bank_load(dragon_bank* bank, u32 s, const ECRYPT_ctx* ctx)
+{
+    u32 j;
+
+    assert(ctx->nlfsr_offset == 0);
+
+    for (j = 0; j < DRAGON_NLFSR_SIZE; j++) {
+        bank->nlfsr[j * bank->capacity + s] = ctx->nlfsr_word[j];
+    }
+    bank->counter[s] = ctx->state_counter[0];
+    bank->counter[bank->capacity + s] = ctx->state_counter[1];
+}
+
+static void dragon_bank_store(const dragon_bank* bank, u32 s, ECRYPT_ctx* ctx)
+{
+    u32 j;
+
+    for (j = 0; j < DRAGON_NLFSR_SIZE; j++) {
+        ctx->nlfsr_word[j] = bank->nlfsr[j * bank->capacity + s];
+    }
+    ctx->state_counter[0] = bank->counter[s];
+    ctx->state_counter[1] = bank->counter[bank->capacity + s];
+    ctx->nlfsr_offset = 0;
+}
+
+static void dragon_bank_wipe_slot(dragon_bank* bank, u32 s)
+{
+    u32 j;
+
+    for (j = 0; j < DRAGON_NLFSR_SIZE; j++) {
+        dragon_wipe(&bank->nlfsr[j * bank->capacity + s], sizeof(u32));
+    }
+    dragon_wipe(&bank->counter[s], sizeof(u32));
+    dragon_wipe(&bank->counter[bank->capacity + s], sizeof(u32));
+}
+
+dragon_bank* DRAGON_bank_create(u32 capacity)
+{
+    dragon_bank* bank;
+
+    assert(capacity > 0 && capacity <= 0x7FFFFFF0);
+
+    capacity = (capacity + DRAGON_BANK_LANES - 1) & ~(DRAGON_BANK_LANES - 1);
+    bank = calloc(1, sizeof(*bank));
+    if (!bank) {
+        return NULL;
+    }
+    bank->nlfsr = aligned_alloc(DRAGON_BANK_ALIGN,
+                                (size_t)DRAGON_NLFSR_SIZE * capacity * sizeof(u32));
+    bank->counter = aligned_alloc(DRAGON_BANK_ALIGN,
+                                  (size_t)2 * capacity * sizeof(u32));
+    bank->generation = calloc(capacity, sizeof(*bank->generation));
+    bank->live = calloc(capacity, sizeof(*bank->live));
+    bank->free_slot = malloc(capacity * sizeof(*bank->free_slot));
+    if (!bank->nlfsr || !bank->counter || !bank->generation ||
+        !bank->live || !bank->free_slot) {
+        DRAGON_bank_destroy(bank);
+        return NULL;
+    }
+    memset(bank->nlfsr, 0, (size_t)DRAGON_NLFSR_SIZE * capacity * sizeof(u32));
+    memset(bank->counter, 0, (size_t)2 * capacity * sizeof(u32));
+    bank->capacity = capacity;
+    return bank;
+}
+
+void DRAGON_bank_destroy(dragon_bank* bank)
+{
+    if (!bank) {
+        return;
+    }
+    if (bank->nlfsr) {
+        dragon_wipe(bank->nlfsr,
+                    (size_t)DRAGON_NLFSR_SIZE * bank->capacity * sizeof(u32));
+    }
+    if (bank->counter) {
+        dragon_wipe(bank->counter, (size_t)2 * bank->capacity * sizeof(u32));
+    }
+    free(bank->nlfsr);
+    free(bank->counter);
+    free(bank->generation);
+    free(bank->live);
+    free(bank->free_slot);
+    free(bank);
+}
+
+int DRAGON_bank_add(
+  dragon_bank* bank,
+  const ECRYPT_ctx* ctx,
+  dragon_slot* handle)
+{
+    u32 s;
+
+    assert(bank && ctx && handle);
+
+    if (bank->free_count > 0) {
+        s = bank->free_slot[--bank->free_count];
+    } else if (bank->top < bank->capacity) {
+        s = bank->top++;
+    } else {
+        return -1;
+    }
+    dragon_bank_load(bank, s, ctx);
+    bank->live[s] = 1;
+    bank->live_count++;
+    handle->slot = s;
+    handle->generation = bank->generation[s];
+    return 0;
+}
+
+int DRAGON_bank_import(
+  dragon_bank* bank,
+  dragon_slot handle,
+  const ECRYPT_ctx* ctx)
+{
+    assert(bank && ctx);
+
+    if (!dragon_bank_valid(bank, handle)) {
+        return -1;
+    }
+    dragon_bank_load(bank, handle.slot, ctx);
+    return 0;
+}
+
+int DRAGON_bank_export(
+  const dragon_bank* bank,
+  dragon_slot handle,
+  ECRYPT_ctx* ctx)
+{
+    assert(bank && ctx);
+
+    if (!dragon_bank_valid(bank, handle)) {
+        return -1;
+    }
+    dragon_bank_store(bank, handle.slot, ctx);
+    dragon_iv_done(ctx, ctx->state_counter[0], ctx->state_counter[1]);
+    return 0;
+}
+
+int DRAGON_bank_remove(
+  dragon_bank* bank,
+  dragon_slot handle)
+{
+    assert(bank);
+
+    if (!dragon_bank_valid(bank, handle)) {
+        return -1;
+    }
+    dragon_bank_wipe_slot(bank, handle.slot);
+    bank->live[handle.slot] = 0;
+    bank->generation[handle.slot]++;
+    bank->free_slot[bank->free_count++] = handle.slot;
+    bank->live_count--;
+    return 0;
+}
+
+/*
+ * Fill the lowest free slot with the highest stream until the streams
+ * are contiguous.
+ */
+u32 DRAGON_bank_compact(
+  dragon_bank* bank,
+  void (*moved)(void* arg, dragon_slot from, dragon_slot to),
+  void* arg)
+{
+    dragon_slot from, to;
+    u32 lo = 0, hi = bank->top;
+    u32 j;
+
+    assert(bank);
+
+    for (;;) {
+        while (lo < hi && bank->live[lo]) {
+            lo++;
+        }
+        while (hi > lo && !bank->live[hi - 1]) {
+            hi--;
+        }
+        if (lo >= hi) {
+            break;
+        }
+        hi--;
+        for (j = 0; j < DRAGON_NLFSR_SIZE; j++) {
+            bank->nlfsr[j * bank->capacity + lo] =
+                bank->nlfsr[j * bank->capacity + hi];
+        }
+        bank->counter[lo] = bank->counter[hi];
+        bank->counter[bank->capacity + lo] = bank->counter[bank->capacity + hi];
+        dragon_bank_wipe_slot(bank, hi);
+
+        from.slot = hi;
+        from.generation = bank->generation[hi]++;
+        to.slot = lo;
+        to.generation = bank->generation[lo];
+        bank->live[lo] = 1;
+        bank->live[hi] = 0;
+        if (moved) {
+            moved(arg, from, to);
+        }
+    }
+    bank->top = bank->live_count;
+    bank->free_count = 0;
+    return bank->live_count;
+}
+
+u32 DRAGON_bank_slots(const dragon_bank* bank)
+{
+    assert(bank);
+
+    return bank->top;
+}
+
+/*
+ * Run the streams of slots first..first+count-1, 16 consecutive slots
+ * at a time. A kernel with a bank entry runs the rows in place;
+ * otherwise the live slots of each group are copied out to contexts
+ * for the multi-stream kernel and back. A NULL input selects keystream
+ * generation.
+ */
+static void dragon_bank_run(
+  dragon_bank* bank,
+  u32 first,
+  u32 count,
+  const u8** input,
+  u8** output,
+  u32 blocks)
+{
+    ECRYPT_ctx lane[DRAGON_BANK_LANES];
+    ECRYPT_ctx* lane_ctx[DRAGON_BANK_LANES];
+    const u8* lane_in[DRAGON_BANK_LANES];
+    u8* lane_out[DRAGON_BANK_LANES];
+    u32 slot[DRAGON_BANK_LANES];
+    const dragon_kernel* kernel = dragon_bound_kernel();
+    u32 base, n, l, i, live;
+    u32 active;
+
+    assert(first <= bank->capacity && count <= bank->capacity - first);
+    assert(blocks % 16 == 0);
+
+    if (blocks == 0) {
+        return;
+    }
+    for (base = 0; base < count; base += n) {
+        n = count - base < DRAGON_BANK_LANES ? count - base : DRAGON_BANK_LANES;
+
+        if (kernel->bank) {
+            active = 0;
+            for (l = 0; l < DRAGON_BANK_LANES; l++) {
+                if (l < n && bank->live[first + base + l]) {
+                    active |= 1u << l;
+                }
+                lane_in[l]  = active >> l & 1 && input ? input[base + l] : NULL;
+                lane_out[l] = active >> l & 1 ? output[base + l] : NULL;
+            }
+            if (active) {
+                kernel->bank(
+                    bank->nlfsr + first + base, bank->capacity,
+                    bank->counter + first + base,
+                    bank->counter + bank->capacity + first + base,
+                    active, input ? lane_in : NULL, lane_out, blocks);
+            }
+            continue;
+        }
+
+        for (l = 0, live = 0; l < n; l++) {
+            if (bank->live[first + base + l]) {
+                slot[live] = first + base + l;
+                dragon_bank_store(bank, slot[live], &lane[live]);
+                lane_ctx[live] = &lane[live];
+                lane_in[live]  = input ? input[base + l] : NULL;
+                lane_out[live] = output[base + l];
+                live++;
+            }
+        }
+        if (live == 0) {
+            continue;
+        }
+        kernel->multi(lane_ctx, input ? lane_in : NULL, lane_out, live,
+                      blocks);
+        for (i = 0; i < live; i++) {
+            dragon_bank_load(bank, slot[i], &lane[i]);
+        }
+        dragon_wipe(lane, live * sizeof(lane[0]));
+    }
+}
+
+void DRAGON_bank_keystream_blocks(
+  dragon_bank* bank,
+  u32 first,
+  u32 count,
+  u8** keystream,
+  u32 blocks)
+{
+    assert(bank && keystream);
+
+    dragon_bank_run(bank, first, count, NULL, keystream, blocks);
+}
+
+void DRAGON_bank_process_blocks(
+  int action,                 /* 0 = encrypt; 1 = decrypt; */
+  dragon_bank* bank,
+  u32 first,
+  u32 count,
+  const u8** input,
+  u8** output,
+  u32 blocks)
+{
+    assert(bank && input && output);
+
+    dragon_bank_run(bank, first, count, input, output, blocks);
+}
@@ -0,0 +1,161 @@
+/**
+ * @file dragon-bank.h
+ * Structure-of-arrays bank of Dragon streams
+ * This source is provided without warranty
+ * or guarantee of any kind. Use at your own risk.
+ */
+#ifndef DRAGON_BANK
+#define DRAGON_BANK
+
+#ifndef _DRAGON_OPT
+#define _DRAGON_OPT
+#endif
+
+#include "ecrypt-sync.h"
+
+/* ------------------------------------------------------------------------- */
+
+/* A bank keeps the running state of many streams in structure-of-arrays
+   form: word j of every stream's NLFSR in one row, then a row of each
+   counter half. Rows are 64-byte aligned and padded to a multiple of 16
+   slots, so a 16-lane kernel loads the state of 16 consecutive slots
+   with one vector load per word instead of transposing 16 contexts.
+   Between calls every NLFSR is at ring offset 0, so no offset row is
+   kept. Streams enter and leave the bank only at block boundaries.
+
+   A slot is named by a handle carrying its generation. Removing a
+   stream wipes the slot and bumps its generation, which turns all
+   handles to it stale; operations on a stale handle fail with -1. A
+   bank is not thread-safe. */
+
+typedef struct dragon_bank dragon_bank;
+
+typedef struct
+{
+    u32  slot;
+    u32  generation;
+} dragon_slot;
+
+/**
+ * Create a bank.
+ * @param  capacity  [In]  number of streams, at least 1; rounded up to
+ *                         a multiple of 16
+ * @return the bank, or NULL if it cannot be allocated
+ */
+dragon_bank* DRAGON_bank_create(u32 capacity);
+
+/**
+ * Wipe and free a bank.
+ * @param  bank  [In]  bank, or NULL
+ */
+void DRAGON_bank_destroy(dragon_bank* bank);
+
+/**
+ * Add a stream, copying its state from a context.
+ * @param  bank    [In/Out]  bank
+ * @param  ctx     [In]      Dragon context after ECRYPT_ivsetup(), at a
+ *                           block boundary
+ * @param  handle  [Out]     handle of the new slot
+ * @return 0 on success, -1 if the bank is full
+ */
+int DRAGON_bank_add(
+  dragon_bank* bank,
+  const ECRYPT_ctx* ctx,
+  dragon_slot* handle);
+
+/**
+ * Overwrite the state of a stream with that of a context.
+ * @param  bank    [In/Out]  bank
+ * @param  handle  [In]      handle of the slot
+ * @param  ctx     [In]      Dragon context at a block boundary
+ * @return 0 on success, -1 if the handle is stale
+ */
+int DRAGON_bank_import(
+  dragon_bank* bank,
+  dragon_slot handle,
+  const ECRYPT_ctx* ctx);
+
+/**
+ * Copy the state of a stream into a context, which then continues the
+ * stream with the ECRYPT functions.
+ * @param  bank    [In]      bank
+ * @param  handle  [In]      handle of the slot
+ * @param  ctx     [In/Out]  Dragon context after ECRYPT_keysetup() with
+ *                           the key of the stream
+ * @return 0 on success, -1 if the handle is stale
+ */
+int DRAGON_bank_export(
+  const dragon_bank* bank,
+  dragon_slot handle,
+  ECRYPT_ctx* ctx);
+
+/**
+ * Remove a stream and wipe its slot.
+ * @param  bank    [In/Out]  bank
+ * @param  handle  [In]      handle of the slot
+ * @return 0 on success, -1 if the handle is stale
+ */
+int DRAGON_bank_remove(
+  dragon_bank* bank,
+  dragon_slot handle);
+
+/**
+ * Move the streams into the lowest slots, so that slots 0 to the
+ * returned count - 1 are all in use. Every move is reported through
+ * moved, if not NULL; the old handle turns stale.
+ * @param  bank   [In/Out]  bank
+ * @param  moved  [In]      callback, or NULL
+ * @param  arg    [In]      first argument of the callback
+ * @return number of streams in the bank
+ */
+u32 DRAGON_bank_compact(
+  dragon_bank* bank,
+  void (*moved)(void* arg, dragon_slot from, dragon_slot to),
+  void* arg);
+
+/**
+ * @return one past the highest slot that may be in use
+ */
+u32 DRAGON_bank_slots(const dragon_bank* bank);
+
+/**
+ * Generate #(blocks) 64-bit blocks of keystream for every stream in
+ * slots first to first + count - 1. Free slots in the range are skipped.
+ * @param  bank       [In/Out]  bank
+ * @param  first      [In]      first slot
+ * @param  count      [In]      number of slots
+ * @param  keystream  [Out]     count pre-allocated arrays of 8*(blocks)
+ *                              bytes, indexed by slot - first
+ * @param  blocks     [In]      number of blocks per stream, a multiple of 16
+ */
+void DRAGON_bank_keystream_blocks(
+  dragon_bank* bank,
+  u32 first,
+  u32 count,
+  u8** keystream,
+  u32 blocks);
+
+/**
+ * Encrypt/Decrypt #(blocks) 64-bit blocks of text for every stream in
+ * slots first to first + count - 1. Free slots in the range are skipped.
+ * @param  action  [In]      This parameter has no meaning for Dragon
+ * @param  bank    [In/Out]  bank
+ * @param  first   [In]      first slot
+ * @param  count   [In]      number of slots
+ * @param  input   [In]      count arrays of (plain/cipher)text blocks,
+ *                           indexed by slot - first
+ * @param  output  [Out]     count pre-allocated arrays of 8*(blocks) bytes
+ * @param  blocks  [In]      number of blocks per stream, a multiple of 16
+ */
+void DRAGON_bank_process_blocks(
+  int action,                 /* 0 = encrypt; 1 = decrypt; */
+  dragon_bank* bank,
+  u32 first,
+  u32 count,
+  const u8** input,
+  u8** output,
+  u32 blocks);
+
+/* ------------------------------------------------------------------------- */
+
+#endif
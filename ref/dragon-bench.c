@@ -0,0 +1,469 @@
+/**
+ * @file dragon-bench.c
+ * Throughput comparison of the Dragon block kernels
+ * Usage: dragon-bench [MiB [vectors.txt]]
+ * With a vector file, every kernel is first checked against its
+ * key/IV/keystream triples. The sync rows write up to 64 MiB of
+ * ciphertext to a file in $TMPDIR (or /tmp) under each durability
+ * policy of dragon-sync.h, in 16 KiB writes as the dragon tool does.
+ * This source is provided without warranty
+ * or guarantee of any kind. Use at your own risk.
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "dragon-bank.h"
+#include "dragon-multi.h"
+#include "dragon-sched.h"
+#include "dragon-sync.h"
+
+#define BENCH_STREAMS   16
+#define BENCH_BLOCKS    2048  /* blocks per stream and call (16 KiB) */
+#define BENCH_VECTOR    (16 * ECRYPT_BLOCKLENGTH)  /* keystream checked */
+
+typedef struct
+{
+    const char* name;
+    const char* cpu;          /* required CPU feature, NULL for none */
+    const char* kernel;       /* dispatch kernel to bind, NULL for none */
+    u32         lanes;
+    void      (*run)(ECRYPT_ctx** ctx, u8** keystream, u32 blocks);
+} bench_kernel;
+
+static void run_scalar(ECRYPT_ctx** ctx, u8** keystream, u32 blocks)
+{
+    ECRYPT_keystream_blocks(ctx[0], keystream[0], blocks);
+}
+
+static void run_ilp2(ECRYPT_ctx** ctx, u8** keystream, u32 blocks)
+{
+    DRAGON_keystream_blocks_ilp(ctx, keystream, 2, blocks);
+}
+
+static void run_ilp4(ECRYPT_ctx** ctx, u8** keystream, u32 blocks)
+{
+    DRAGON_keystream_blocks_ilp(ctx, keystream, 4, blocks);
+}
+
+static void run_x8(ECRYPT_ctx** ctx, u8** keystream, u32 blocks)
+{
+    DRAGON_keystream_blocks_x8(ctx, keystream, blocks);
+}
+
+static void run_x16(ECRYPT_ctx** ctx, u8** keystream, u32 blocks)
+{
+    u32 n[DRAGON_AVX512_LANES];
+    u32 lane;
+
+    for (lane = 0; lane < DRAGON_AVX512_LANES; lane++) {
+        n[lane] = blocks;
+    }
+    DRAGON_keystream_blocks_x16(ctx, keystream, n);
+}
+
+static void run_x16_perm(ECRYPT_ctx** ctx, u8** keystream, u32 blocks)
+{
+    u32 n[DRAGON_AVX512_LANES];
+    u32 lane;
+
+    for (lane = 0; lane < DRAGON_AVX512_LANES; lane++) {
+        n[lane] = blocks;
+    }
+    DRAGON_keystream_blocks_x16_perm(ctx, keystream, n);
+}
+
+static void run_multi(ECRYPT_ctx** ctx, u8** keystream, u32 blocks)
+{
+    DRAGON_keystream_blocks_multi(ctx, keystream, BENCH_STREAMS, blocks);
+}
+
+/* the streams pass through a bank, whose SoA rows need no transposes */
+static void run_bank(ECRYPT_ctx** ctx, u8** keystream, u32 blocks)
+{
+    static dragon_bank* bank;
+    static dragon_slot slot[BENCH_STREAMS];
+    u32 lane;
+
+    if (!bank) {
+        bank = DRAGON_bank_create(BENCH_STREAMS);
+        for (lane = 0; lane < BENCH_STREAMS; lane++) {
+            DRAGON_bank_add(bank, ctx[lane], &slot[lane]);
+        }
+    }
+    for (lane = 0; lane < BENCH_STREAMS; lane++) {
+        DRAGON_bank_import(bank, slot[lane], ctx[lane]);
+    }
+    DRAGON_bank_keystream_blocks(bank, 0, BENCH_STREAMS, keystream, blocks);
+    for (lane = 0; lane < BENCH_STREAMS; lane++) {
+        DRAGON_bank_export(bank, slot[lane], ctx[lane]);
+    }
+}
+
+static const bench_kernel kernels[] =
+{
+    { "scalar",       NULL,      "scalar",      1,  run_scalar   },
+    { "scalar-wide",  NULL,      "scalar-wide", 1,  run_scalar   },
+    { "scalar-packed",NULL,      "scalar-packed",1, run_scalar   },
+    { "ilp2",         NULL,      NULL,          2,  run_ilp2     },
+    { "ilp4",         NULL,      NULL,          4,  run_ilp4     },
+    { "avx2-gather",  "avx2",    NULL,          8,  run_x8       },
+    { "avx512-gather","avx512f", NULL,          16, run_x16      },
+    { "avx512-perm",  "avx512f", NULL,          16, run_x16_perm },
+    { "multi",        NULL,      NULL,          16, run_multi    },
+    { "bank",         NULL,      NULL,          16, run_bank     },
+};
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int cpu_has(const char* feature)
+{
+    if (!feature)
+        return 1;
+    __builtin_cpu_init();
+    if (!strcmp(feature, "avx2"))
+        return __builtin_cpu_supports("avx2");
+    if (!strcmp(feature, "avx512f"))
+        return __builtin_cpu_supports("avx512f");
+    return 0;
+}
+
+static void setup(ECRYPT_ctx* ctx)
+{
+    u8 key[32], iv[32];
+    u32 lane, i;
+
+    for (lane = 0; lane < BENCH_STREAMS; lane++) {
+        for (i = 0; i < 32; i++) {
+            key[i] = (u8)(lane * 32 + i);
+            iv[i]  = (u8)(lane + i * 7);
+        }
+        memset(&ctx[lane], 0, sizeof(ctx[lane]));
+        ECRYPT_keysetup(&ctx[lane], key, 256, 256);
+        ECRYPT_ivsetup(&ctx[lane], iv);
+    }
+}
+
+/*
+ * Parse a hex string into at most max bytes. Returns the byte count.
+ */
+static u32 parse_hex(const char* line, u8* out, u32 max)
+{
+    u32 n = 0;
+    unsigned int v;
+
+    while (n < max && sscanf(line, "%2x", &v) == 1) {
+        out[n++] = (u8)v;
+        line += 2;
+    }
+    return n;
+}
+
+/*
+ * Run every supported kernel over each vector of the file, with the
+ * vector's key and IV in all lanes. Returns the number of failures, or
+ * -1 if the file cannot be read.
+ */
+static int check_vectors(
+  const char* path,
+  ECRYPT_ctx* ctx,
+  ECRYPT_ctx** ctxp,
+  u8** bufp)
+{
+    char line[256];
+    u8 key[32], iv[32], expect[BENCH_VECTOR];
+    u32 keylen = 0, ivlen = 0, len = 0, vectors = 0;
+    u8* field = NULL;
+    int failed = 0;
+    FILE* f;
+    size_t k;
+    u32 lane;
+
+    f = fopen(path, "r");
+    if (!f) {
+        return -1;
+    }
+    for (;;) {
+        int more = fgets(line, sizeof(line), f) != NULL;
+
+        if (more && !strncmp(line, "Key:", 4)) {
+            field = key;
+        } else if (more && !strncmp(line, "IV:", 3)) {
+            field = iv;
+        } else if (more && !strncmp(line, "Keystream:", 10)) {
+            field = expect;
+            len = 0;
+        } else if (more && field == key) {
+            keylen = parse_hex(line, key, sizeof(key));
+            field = NULL;
+        } else if (more && field == iv) {
+            ivlen = parse_hex(line, iv, sizeof(iv));
+            field = NULL;
+        } else if (more && field == expect && line[0] != '\n') {
+            len += parse_hex(line, expect + len, sizeof(expect) - len);
+        } else if (field == expect) {
+            /* end of a vector: run it through every kernel */
+            for (k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+                const bench_kernel* kern = &kernels[k];
+
+                if (!cpu_has(kern->cpu) ||
+                    (kern->kernel && DRAGON_select_kernel(kern->kernel) != 0)) {
+                    continue;
+                }
+                for (lane = 0; lane < BENCH_STREAMS; lane++) {
+                    memset(&ctx[lane], 0, sizeof(ctx[lane]));
+                    ECRYPT_keysetup(&ctx[lane], key, keylen * 8, ivlen * 8);
+                    ECRYPT_ivsetup(&ctx[lane], iv);
+                }
+                kern->run(ctxp, bufp, 16);
+                for (lane = 0; lane < kern->lanes; lane++) {
+                    if (memcmp(bufp[lane], expect, len)) {
+                        printf("vector %u: %s MISMATCH\n", vectors, kern->name);
+                        failed++;
+                        break;
+                    }
+                }
+            }
+            vectors++;
+            field = NULL;
+        }
+        if (!more) {
+            break;
+        }
+    }
+    fclose(f);
+    printf("vectors: %u checked, %d failed\n", vectors, failed);
+    return failed;
+}
+
+/*
+ * Packets of 40 to 1500 bytes under one key, one ECRYPT_process_packet()
+ * call each versus one DRAGON_process_packets() call per batch, and
+ * versus submitting them one by one to a scheduler.
+ */
+#define BENCH_PACKETS   256
+
+static void bench_packets(double mib)
+{
+    static u8 data[BENCH_PACKETS][1500];
+    static u8 ivs[BENCH_PACKETS][32];
+    static ECRYPT_ctx sctx[BENCH_PACKETS];
+    dragon_sched* sched;
+    dragon_sched_stats stats;
+    const u8* iv[BENCH_PACKETS];
+    const u8* in[BENCH_PACKETS];
+    u8* out[BENCH_PACKETS];
+    u32 len[BENCH_PACKETS];
+    ECRYPT_ctx key, ctx;
+    double bytes = 0, t;
+    u32 calls, i, p;
+
+    for (p = 0; p < BENCH_PACKETS; p++) {
+        len[p] = 40 + (p * 1021) % 1461;
+        bytes += len[p];
+        memset(ivs[p], (int)p, sizeof(ivs[p]));
+        iv[p] = ivs[p];
+        in[p] = out[p] = data[p];
+    }
+    memset(&key, 0, sizeof(key));
+    ECRYPT_keysetup(&key, ivs[1], 256, 256);
+    calls = (u32)(mib * 1048576.0 / bytes) + 1;
+
+    t = now();
+    for (i = 0; i < calls; i++) {
+        for (p = 0; p < BENCH_PACKETS; p++) {
+            ctx = key;
+            ECRYPT_process_packet(0, &ctx, iv[p], in[p], out[p], len[p]);
+        }
+    }
+    t = now() - t;
+    printf("%-16s %5u %12.1f\n", "packet", 1, calls * bytes / t / 1e6);
+
+    t = now();
+    for (i = 0; i < calls; i++) {
+        DRAGON_process_packets(0, &key, iv, in, out, len, BENCH_PACKETS);
+    }
+    t = now() - t;
+    printf("%-16s %5u %12.1f\n", "packets", DRAGON_PACKET_LANES,
+           calls * bytes / t / 1e6);
+
+    sched = DRAGON_sched_create(BENCH_PACKETS, BENCH_PACKETS);
+    if (!sched) {
+        return;
+    }
+    t = now();
+    for (i = 0; i < calls; i++) {
+        for (p = 0; p < BENCH_PACKETS; p++) {
+            sctx[p] = key;
+            ECRYPT_ivsetup(&sctx[p], iv[p]);
+            DRAGON_sched_submit(sched, &sctx[p], in[p], out[p], len[p],
+                                NULL, NULL, p);
+        }
+        DRAGON_sched_flush(sched);
+    }
+    t = now() - t;
+    DRAGON_sched_stats(sched, &stats);
+    printf("%-16s %5u %12.1f  occupancy %.2f\n", "sched", DRAGON_SCHED_LANES,
+           calls * bytes / t / 1e6,
+           stats.lane_groups ? (double)stats.busy_groups / stats.lane_groups : 0);
+    DRAGON_sched_destroy(sched);
+}
+
+/*
+ * Encrypt and write a file under each durability policy, timed up to
+ * and including close().
+ */
+#define BENCH_SYNC_MAX   64    /* MiB written per policy */
+#define BENCH_SYNC_RANGE  8    /* MiB per range of DRAGON_SYNC_RANGE */
+
+static void bench_sync(double mib)
+{
+    static const struct
+    {
+        const char* name;
+        int         mode;
+    } policy[] = {
+        { "sync-write", DRAGON_SYNC_WRITE },
+        { "sync-close", DRAGON_SYNC_CLOSE },
+        { "sync-range", DRAGON_SYNC_RANGE },
+        { "sync-none",  DRAGON_SYNC_NONE },
+    };
+    static u8 data[BENCH_BLOCKS * ECRYPT_BLOCKLENGTH];
+    static const u8 key[32], iv[32];
+    char path[4096];
+    const char* dir = getenv("TMPDIR");
+    dragon_sync sync;
+    ECRYPT_ctx ctx;
+    double t;
+    u32 chunks, i;
+    size_t p;
+    int fd, failed;
+
+    if (mib > BENCH_SYNC_MAX) {
+        mib = BENCH_SYNC_MAX;
+    }
+    chunks = (u32)(mib * 1048576.0 / sizeof(data)) + 1;
+    snprintf(path, sizeof(path), "%s/dragon-bench-XXXXXX", dir ? dir : "/tmp");
+    fd = mkstemp(path);
+    if (fd < 0) {
+        printf("%-16s %5s %12s\n", "sync", "", "n/a");
+        return;
+    }
+    close(fd);
+
+    for (p = 0; p < sizeof(policy) / sizeof(policy[0]); p++) {
+        sync.mode  = policy[p].mode;
+        sync.every = (u64)BENCH_SYNC_RANGE << 20;
+        sync.done  = 0;
+        memset(&ctx, 0, sizeof(ctx));
+        ECRYPT_keysetup(&ctx, key, 256, 256);
+        ECRYPT_ivsetup(&ctx, iv);
+        failed = 0;
+
+        t = now();
+        fd = open(path, O_WRONLY | O_TRUNC | dragon_sync_flags(&sync));
+        if (fd < 0) {
+            break;
+        }
+        for (i = 0; i < chunks && !failed; i++) {
+            ECRYPT_process_bytes(0, &ctx, data, data, sizeof(data));
+            failed = write(fd, data, sizeof(data)) != (ssize_t)sizeof(data);
+            dragon_sync_progress(&sync, fd, (u64)(i + 1) * sizeof(data));
+        }
+        failed |= dragon_sync_close(&sync, fd) != 0;
+        close(fd);
+        t = now() - t;
+
+        if (failed) {
+            printf("%-16s %5u %12s\n", policy[p].name, 1, "n/a");
+        } else {
+            printf("%-16s %5u %12.1f\n", policy[p].name, 1,
+                   (double)chunks * sizeof(data) / t / 1e6);
+        }
+    }
+    unlink(path);
+}
+
+int main(int argc, char* argv[])
+{
+    static ECRYPT_ctx ctx[BENCH_STREAMS];
+    static u8 buf[BENCH_STREAMS][BENCH_BLOCKS * ECRYPT_BLOCKLENGTH];
+    static u8 ref[BENCH_STREAMS][16 * ECRYPT_BLOCKLENGTH];
+    ECRYPT_ctx* ctxp[BENCH_STREAMS];
+    u8* bufp[BENCH_STREAMS];
+    double mib = argc > 1 ? atof(argv[1]) : 256;
+    const char* dispatched;
+    size_t k;
+    u32 lane;
+
+    ECRYPT_init();
+
+    /* the first 16 blocks of every stream, for the bit-exactness check */
+    setup(ctx);
+    for (lane = 0; lane < BENCH_STREAMS; lane++) {
+        ECRYPT_keystream_blocks(&ctx[lane], ref[lane], 16);
+        ctxp[lane] = &ctx[lane];
+        bufp[lane] = buf[lane];
+    }
+
+    dispatched = DRAGON_kernel_name();
+    printf("dispatch: %s\n", dispatched);
+    if (argc > 2) {
+        int failed = check_vectors(argv[2], ctx, ctxp, bufp);
+
+        DRAGON_select_kernel(dispatched);
+        if (failed != 0) {
+            if (failed < 0) {
+                printf("cannot read %s\n", argv[2]);
+            }
+            return 1;
+        }
+    }
+    printf("%-16s %5s %12s\n", "kernel", "lanes", "MB/s");
+    for (k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+        const bench_kernel* kern = &kernels[k];
+        u32 calls, i;
+        double t;
+
+        DRAGON_select_kernel(dispatched);
+        if (!cpu_has(kern->cpu) ||
+            (kern->kernel && DRAGON_select_kernel(kern->kernel) != 0)) {
+            printf("%-16s %5u %12s\n", kern->name, kern->lanes, "n/a");
+            continue;
+        }
+        setup(ctx);
+        kern->run(ctxp, bufp, 16);
+        for (lane = 0; lane < kern->lanes; lane++) {
+            if (memcmp(buf[lane], ref[lane], sizeof(ref[lane]))) {
+                printf("%-16s %5u %12s\n", kern->name, kern->lanes, "MISMATCH");
+                return 1;
+            }
+        }
+
+        calls = (u32)(mib * 1048576.0 / sizeof(buf[0]) / kern->lanes) + 1;
+        t = now();
+        for (i = 0; i < calls; i++) {
+            kern->run(ctxp, bufp, BENCH_BLOCKS);
+        }
+        t = now() - t;
+        printf("%-16s %5u %12.1f\n", kern->name, kern->lanes,
+               (double)calls * kern->lanes * sizeof(buf[0]) / t / 1e6);
+    }
+    DRAGON_select_kernel(dispatched);
+    bench_packets(mib);
+    bench_sync(mib);
+
+    return 0;
+}
@@ -0,0 +1,254 @@
+/**
+ * @file dragon-cache.c
+ * Cache of Dragon states after IV setup
+ * This source is provided without warranty
+ * or guarantee of any kind. Use at your own risk.
+ */
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dragon-cache.h"
+#include "dragon-dispatch.h"
+
+#define DRAGON_CACHE_NONE  0xFFFFFFFF  /* end of a list */
+#define DRAGON_IV_MAX      32          /* IV bytes for a 256-bit key */
+
+/**
+ * Entries live in one array and are linked by index into a hash chain
+ * per bucket and into the LRU list, most recently used first.
+ */
+typedef struct
+{
+    u32  key_id;
+    u32  iv_size;
+    u8   iv[DRAGON_IV_MAX];
+    u32  nlfsr_word[DRAGON_NLFSR_SIZE];
+    u32  state_counter[2];
+    u32  chain;               /* next entry in the bucket */
+    u32  prev, next;          /* LRU neighbours */
+} dragon_cache_entry;
+
+struct dragon_cache
+{
+    dragon_cache_entry* entry;
+    u32* bucket;
+    u32  mask;                /* number of buckets - 1 */
+    u32  capacity;
+    u32  used;
+    u32  head, tail;          /* most and least recently used */
+    u64  hits;
+    u64  misses;
+};
+
+/*
+ * Zero memory in a way the compiler may not elide.
+ */
+static void dragon_wipe(void* p, size_t n)
+{
+    volatile u8* v = (volatile u8*)p;
+
+    while (n--) {
+        *v++ = 0;
+    }
+}
+
+static u32 dragon_cache_hash(u32 key_id, const u8* iv, u32 iv_size)
+{
+    u32 h = 0x811C9DC5 ^ key_id;
+    u32 i;
+
+    for (i = 0; i < iv_size; i++) {
+        h = (h ^ iv[i]) * 0x01000193;
+    }
+    return h ^ (h >> 16);
+}
+
+static void dragon_lru_unlink(dragon_cache* cache, u32 i)
+{
+    dragon_cache_entry* e = &cache->entry[i];
+
+    if (e->prev != DRAGON_CACHE_NONE) {
+        cache->entry[e->prev].next = e->next;
+    } else {
+        cache->head = e->next;
+    }
+    if (e->next != DRAGON_CACHE_NONE) {
+        cache->entry[e->next].prev = e->prev;
+    } else {
+        cache->tail = e->prev;
+    }
+}
+
+static void dragon_lru_push(dragon_cache* cache, u32 i)
+{
+    dragon_cache_entry* e = &cache->entry[i];
+
+    e->prev = DRAGON_CACHE_NONE;
+    e->next = cache->head;
+    if (cache->head != DRAGON_CACHE_NONE) {
+        cache->entry[cache->head].prev = i;
+    } else {
+        cache->tail = i;
+    }
+    cache->head = i;
+}
+
+/*
+ * Unlink entry i from its bucket and the LRU list and wipe it. The
+ * slot is then reused as the last slot in use, so that entries
+ * 0..used-1 stay occupied.
+ */
+static void dragon_cache_drop(dragon_cache* cache, u32 i)
+{
+    dragon_cache_entry* e = &cache->entry[i];
+    u32* link = &cache->bucket[dragon_cache_hash(e->key_id, e->iv, e->iv_size) & cache->mask];
+    u32 last;
+
+    while (*link != i) {
+        link = &cache->entry[*link].chain;
+    }
+    *link = e->chain;
+    dragon_lru_unlink(cache, i);
+
+    /* move the last entry into the hole */
+    last = --cache->used;
+    if (i != last) {
+        dragon_cache_entry* l = &cache->entry[last];
+
+        link = &cache->bucket[dragon_cache_hash(l->key_id, l->iv, l->iv_size) & cache->mask];
+        while (*link != last) {
+            link = &cache->entry[*link].chain;
+        }
+        *link = i;
+        if (l->prev != DRAGON_CACHE_NONE) {
+            cache->entry[l->prev].next = i;
+        } else {
+            cache->head = i;
+        }
+        if (l->next != DRAGON_CACHE_NONE) {
+            cache->entry[l->next].prev = i;
+        } else {
+            cache->tail = i;
+        }
+        memcpy(e, l, sizeof(*e));
+    }
+    dragon_wipe(&cache->entry[last], sizeof(cache->entry[last]));
+}
+
+dragon_cache* DRAGON_cache_create(u32 entries)
+{
+    dragon_cache* cache;
+    u32 buckets = 1;
+
+    assert(entries > 0);
+
+    while (buckets < entries && buckets < 0x80000000) {
+        buckets <<= 1;
+    }
+    cache = calloc(1, sizeof(*cache));
+    if (!cache) {
+        return NULL;
+    }
+    cache->entry = calloc(entries, sizeof(*cache->entry));
+    cache->bucket = malloc(buckets * sizeof(*cache->bucket));
+    if (!cache->entry || !cache->bucket) {
+        free(cache->entry);
+        free(cache->bucket);
+        free(cache);
+        return NULL;
+    }
+    memset(cache->bucket, 0xFF, buckets * sizeof(*cache->bucket));
+    cache->mask = buckets - 1;
+    cache->capacity = entries;
+    cache->head = cache->tail = DRAGON_CACHE_NONE;
+    return cache;
+}
+
+void DRAGON_cache_destroy(dragon_cache* cache)
+{
+    if (!cache) {
+        return;
+    }
+    dragon_wipe(cache->entry, cache->capacity * sizeof(*cache->entry));
+    free(cache->entry);
+    free(cache->bucket);
+    free(cache);
+}
+
+int DRAGON_cache_ivsetup(
+  dragon_cache* cache,
+  ECRYPT_ctx* ctx,
+  u32 key_id,
+  const u8* iv)
+{
+    u32 iv_size = ctx->key_size / 8;
+    u32 h, i;
+    dragon_cache_entry* e;
+
+    assert(cache && ctx && iv);
+    assert(iv_size <= DRAGON_IV_MAX);
+
+    h = dragon_cache_hash(key_id, iv, iv_size) & cache->mask;
+    for (i = cache->bucket[h]; i != DRAGON_CACHE_NONE; i = e->chain) {
+        e = &cache->entry[i];
+        if (e->key_id == key_id && e->iv_size == iv_size &&
+            !memcmp(e->iv, iv, iv_size)) {
+            memcpy(ctx->nlfsr_word, e->nlfsr_word, sizeof(ctx->nlfsr_word));
+            dragon_iv_done(ctx, e->state_counter[0], e->state_counter[1]);
+            dragon_lru_unlink(cache, i);
+            dragon_lru_push(cache, i);
+            cache->hits++;
+            return 1;
+        }
+    }
+
+    cache->misses++;
+    ECRYPT_ivsetup(ctx, iv);
+
+    if (cache->used == cache->capacity) {
+        dragon_cache_drop(cache, cache->tail);
+    }
+    i = cache->used++;
+    e = &cache->entry[i];
+    e->key_id = key_id;
+    e->iv_size = iv_size;
+    memcpy(e->iv, iv, iv_size);
+    memcpy(e->nlfsr_word, ctx->nlfsr_word, sizeof(e->nlfsr_word));
+    e->state_counter[0] = ctx->state_counter[0];
+    e->state_counter[1] = ctx->state_counter[1];
+    e->chain = cache->bucket[h];
+    cache->bucket[h] = i;
+    dragon_lru_push(cache, i);
+    return 0;
+}
+
+void DRAGON_cache_forget_key(
+  dragon_cache* cache,
+  u32 key_id)
+{
+    u32 i;
+
+    assert(cache);
+
+    for (i = cache->used; i-- > 0; ) {
+        if (cache->entry[i].key_id == key_id) {
+            dragon_cache_drop(cache, i);
+        }
+    }
+}
+
+void DRAGON_cache_stats(
+  const dragon_cache* cache,
+  u64* hits,
+  u64* misses)
+{
+    assert(cache);
+
+    if (hits) {
+        *hits = cache->hits;
+    }
+    if (misses) {
+        *misses = cache->misses;
+    }
+}
@@ -0,0 +1,79 @@
+/**
+ * @file dragon-cache.h
+ * Cache of Dragon states after IV setup
+ * This source is provided without warranty
+ * or guarantee of any kind. Use at your own risk.
+ */
+#ifndef DRAGON_CACHE
+#define DRAGON_CACHE
+
+#ifndef _DRAGON_OPT
+#define _DRAGON_OPT
+#endif
+
+#include "ecrypt-sync.h"
+
+/* ------------------------------------------------------------------------- */
+
+/* Post-IV-setup state cache. An entry holds the NLFSR and counter that
+   ECRYPT_ivsetup() produces for a (key, IV) pair; on a hit they are
+   copied into the context instead of running the 16 mixing stages.
+   Keys are named by caller-chosen ids: the caller guarantees that a
+   context passed with a key id was set up with that key, and calls
+   DRAGON_cache_forget_key() before an id is reused for another key.
+   Least recently used entries are evicted first. Evicted, forgotten
+   and destroyed entries are wiped. A cache is not thread-safe. */
+
+typedef struct dragon_cache dragon_cache;
+
+/**
+ * Create a cache.
+ * @param  entries  [In]  maximum number of cached states, at least 1
+ * @return the cache, or NULL if it cannot be allocated
+ */
+dragon_cache* DRAGON_cache_create(u32 entries);
+
+/**
+ * Wipe and free a cache.
+ * @param  cache  [In]  cache, or NULL
+ */
+void DRAGON_cache_destroy(dragon_cache* cache);
+
+/**
+ * IV setup through the cache: same effect as ECRYPT_ivsetup().
+ * @param  cache   [In/Out]  cache
+ * @param  ctx     [In/Out]  Dragon context after ECRYPT_keysetup() with
+ *                           the key named key_id
+ * @param  key_id  [In]      id of the key
+ * @param  iv      [In]      IV
+ * @return 1 on a hit, 0 on a miss
+ */
+int DRAGON_cache_ivsetup(
+  dragon_cache* cache,
+  ECRYPT_ctx* ctx,
+  u32 key_id,
+  const u8* iv);
+
+/**
+ * Wipe all entries of a key.
+ * @param  cache   [In/Out]  cache
+ * @param  key_id  [In]      id of the key
+ */
+void DRAGON_cache_forget_key(
+  dragon_cache* cache,
+  u32 key_id);
+
+/**
+ * Read the hit and miss counters.
+ * @param  cache   [In]   cache
+ * @param  hits    [Out]  number of hits, or NULL
+ * @param  misses  [Out]  number of misses, or NULL
+ */
+void DRAGON_cache_stats(
+  const dragon_cache* cache,
+  u64* hits,
+  u64* misses);
+
+/* ------------------------------------------------------------------------- */
+
+#endif
@@ -0,0 +1,371 @@
+/**
+ * @file dragon-dispatch.c
+ * Runtime selection of the Dragon block kernels
+ * This source is provided without warranty
+ * or guarantee of any kind. Use at your own risk.
+ */
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dragon-dispatch.h"
+
+/**
+ * Multi-stream adapters. Each runs any number of streams through a
+ * kernel of fixed lane count; leftover streams go to the next smaller
+ * kernel, or, for the masked AVX-512 kernel, to idle lanes.
+ */
+static void scalar_multi(
+  ECRYPT_ctx** ctx,
+  const u8** input,
+  u8** output,
+  u32 streams,
+  u32 blocks)
+{
+    u32 s;
+
+    for (s = 0; s < streams; s++) {
+        dragon_scalar_blocks(ctx[s], input ? input[s] : NULL, output[s], blocks);
+    }
+}
+
+static void wide_multi(
+  ECRYPT_ctx** ctx,
+  const u8** input,
+  u8** output,
+  u32 streams,
+  u32 blocks)
+{
+    u32 s;
+
+    for (s = 0; s < streams; s++) {
+        dragon_wide_blocks(ctx[s], input ? input[s] : NULL, output[s], blocks);
+    }
+}
+
+static void packed_multi(
+  ECRYPT_ctx** ctx,
+  const u8** input,
+  u8** output,
+  u32 streams,
+  u32 blocks)
+{
+    u32 s;
+
+    for (s = 0; s < streams; s++) {
+        dragon_packed_blocks(ctx[s], input ? input[s] : NULL, output[s], blocks);
+    }
+}
+
+static void ilp_multi(
+  ECRYPT_ctx** ctx,
+  const u8** input,
+  u8** output,
+  u32 streams,
+  u32 blocks)
+{
+    if (input) {
+        DRAGON_process_blocks_ilp(0, ctx, input, output, streams, blocks);
+    } else {
+        DRAGON_keystream_blocks_ilp(ctx, output, streams, blocks);
+    }
+}
+
+static void avx2_multi(
+  ECRYPT_ctx** ctx,
+  const u8** input,
+  u8** output,
+  u32 streams,
+  u32 blocks)
+{
+    for (; streams >= DRAGON_AVX2_LANES; streams -= DRAGON_AVX2_LANES) {
+        if (input) {
+            DRAGON_process_blocks_x8(0, ctx, input, output, blocks);
+            input += DRAGON_AVX2_LANES;
+        } else {
+            DRAGON_keystream_blocks_x8(ctx, output, blocks);
+        }
+        ctx += DRAGON_AVX2_LANES;
+        output += DRAGON_AVX2_LANES;
+    }
+    ilp_multi(ctx, input, output, streams, blocks);
+}
+
+static void avx512_lanes(
+  ECRYPT_ctx** ctx,
+  const u8** input,
+  u8** output,
+  u32 streams,
+  u32 blocks,
+  int perm)
+{
+    ECRYPT_ctx* lane_ctx[DRAGON_AVX512_LANES];
+    const u8* lane_in[DRAGON_AVX512_LANES];
+    u8* lane_out[DRAGON_AVX512_LANES];
+    u32 lane_blocks[DRAGON_AVX512_LANES];
+    u32 n, lane;
+
+    while (streams > 0) {
+        n = streams < DRAGON_AVX512_LANES ? streams : DRAGON_AVX512_LANES;
+        for (lane = 0; lane < DRAGON_AVX512_LANES; lane++) {
+            lane_ctx[lane]    = lane < n ? ctx[lane] : NULL;
+            lane_in[lane]     = lane < n && input ? input[lane] : NULL;
+            lane_out[lane]    = lane < n ? output[lane] : NULL;
+            lane_blocks[lane] = lane < n ? blocks : 0;
+        }
+        if (input && perm) {
+            DRAGON_process_blocks_x16_perm(0, lane_ctx, lane_in, lane_out, lane_blocks);
+        } else if (input) {
+            DRAGON_process_blocks_x16(0, lane_ctx, lane_in, lane_out, lane_blocks);
+        } else if (perm) {
+            DRAGON_keystream_blocks_x16_perm(lane_ctx, lane_out, lane_blocks);
+        } else {
+            DRAGON_keystream_blocks_x16(lane_ctx, lane_out, lane_blocks);
+        }
+        ctx += n;
+        input = input ? input + n : NULL;
+        output += n;
+        streams -= n;
+    }
+}
+
+static void avx512_multi(
+  ECRYPT_ctx** ctx,
+  const u8** input,
+  u8** output,
+  u32 streams,
+  u32 blocks)
+{
+    avx512_lanes(ctx, input, output, streams, blocks, 0);
+}
+
+static void avx512_perm_multi(
+  ECRYPT_ctx** ctx,
+  const u8** input,
+  u8** output,
+  u32 streams,
+  u32 blocks)
+{
+    avx512_lanes(ctx, input, output, streams, blocks, 1);
+}
+
+/**
+ * IV setup adapters. The SIMD ones fill idle lanes with NULL.
+ */
+static void scalar_ivsetup(
+  ECRYPT_ctx** ctx,
+  const u8** iv,
+  u32 streams)
+{
+    u32 s;
+
+    for (s = 0; s < streams; s++) {
+        ECRYPT_ivsetup(ctx[s], iv[s]);
+    }
+}
+
+static void avx2_ivsetup(
+  ECRYPT_ctx** ctx,
+  const u8** iv,
+  u32 streams)
+{
+    ECRYPT_ctx* lane_ctx[DRAGON_AVX2_LANES];
+    const u8* lane_iv[DRAGON_AVX2_LANES];
+    u32 n, lane;
+
+    for (; streams > 0; streams -= n) {
+        n = streams < DRAGON_AVX2_LANES ? streams : DRAGON_AVX2_LANES;
+        for (lane = 0; lane < DRAGON_AVX2_LANES; lane++) {
+            lane_ctx[lane] = lane < n ? ctx[lane] : NULL;
+            lane_iv[lane]  = lane < n ? iv[lane] : NULL;
+        }
+        DRAGON_ivsetup_x8(lane_ctx, lane_iv);
+        ctx += n;
+        iv += n;
+    }
+}
+
+static void avx512_ivsetup(
+  ECRYPT_ctx** ctx,
+  const u8** iv,
+  u32 streams)
+{
+    ECRYPT_ctx* lane_ctx[DRAGON_AVX512_LANES];
+    const u8* lane_iv[DRAGON_AVX512_LANES];
+    u32 n, lane;
+
+    for (; streams > 0; streams -= n) {
+        n = streams < DRAGON_AVX512_LANES ? streams : DRAGON_AVX512_LANES;
+        for (lane = 0; lane < DRAGON_AVX512_LANES; lane++) {
+            lane_ctx[lane] = lane < n ? ctx[lane] : NULL;
+            lane_iv[lane]  = lane < n ? iv[lane] : NULL;
+        }
+        DRAGON_ivsetup_x16(lane_ctx, lane_iv);
+        ctx += n;
+        iv += n;
+    }
+}
+
+/**
+ * Known kernels, slowest first. Automatic selection binds the last one
+ * up to DRAGON_AUTO that the CPU supports; the others are only bound on
+ * request.
+ */
+static const dragon_kernel dragon_kernels[] =
+{
+    { "scalar",        NULL,      NULL,
+      dragon_scalar_blocks, scalar_multi,      scalar_ivsetup, NULL },
+    { "ilp",           NULL,      NULL,
+      dragon_scalar_blocks, ilp_multi,         scalar_ivsetup, NULL },
+    { "avx2",          "avx2",    NULL,
+      dragon_scalar_blocks, avx2_multi,        avx2_ivsetup,   NULL },
+    { "avx512",        "avx512f", NULL,
+      dragon_scalar_blocks, avx512_multi,      avx512_ivsetup,
+      dragon_x16_soa_blocks },
+    { "avx512-perm",   "avx512f", NULL,
+      dragon_scalar_blocks, avx512_perm_multi, avx512_ivsetup,
+      dragon_x16_soa_blocks_perm },
+    { "scalar-wide",   NULL,      dragon_wide_init,
+      dragon_wide_blocks,   wide_multi,        scalar_ivsetup, NULL },
+    { "scalar-packed", NULL,      NULL,
+      dragon_packed_blocks, packed_multi,      scalar_ivsetup, NULL },
+};
+
+#define DRAGON_KERNELS  (sizeof(dragon_kernels) / sizeof(dragon_kernels[0]))
+#define DRAGON_AUTO     3   /* last kernel eligible for automatic selection */
+
+_Atomic(const dragon_kernel*) dragon_active_kernel = &dragon_kernels[0];
+
+static int dragon_cpu_supports(const char* feature)
+{
+    if (!feature) {
+        return 1;
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (!strcmp(feature, "avx2")) {
+        return __builtin_cpu_supports("avx2");
+    }
+    if (!strcmp(feature, "avx512f")) {
+        return __builtin_cpu_supports("avx512f");
+    }
+#endif
+    return 0;
+}
+
+/*
+ * Bind the fastest supported kernel, unless the DRAGON_KERNEL
+ * environment variable names a supported kernel. A name that cannot
+ * be bound is reported on stderr, once, and then ignored.
+ */
+static void dragon_dispatch_probe(void)
+{
+    const char* forced;
+    u32 k;
+
+    forced = getenv("DRAGON_KERNEL");
+    if (forced) {
+        if (DRAGON_select_kernel(forced) == 0) {
+            return;
+        }
+        fprintf(stderr, "dragon: DRAGON_KERNEL=%s is unknown or not "
+                "supported here, ignored\n", forced);
+    }
+    for (k = DRAGON_AUTO + 1; k-- > 0; ) {
+        if (dragon_cpu_supports(dragon_kernels[k].cpu)) {
+            atomic_store_explicit(&dragon_active_kernel, &dragon_kernels[k],
+                                  memory_order_release);
+            return;
+        }
+    }
+}
+
+void dragon_dispatch_init(void)
+{
+    static pthread_once_t probed = PTHREAD_ONCE_INIT;
+
+    pthread_once(&probed, dragon_dispatch_probe);
+}
+
+/**
+ * Bind the named kernel.
+ * @param  name  [In]  kernel name, as returned by DRAGON_kernel_name()
+ * @return 0 on success, -1 if the kernel is unknown, not supported
+ *         by this CPU, or its tables cannot be built
+ */
+int DRAGON_select_kernel(const char* name)
+{
+    u32 k;
+
+    assert(name);
+
+    for (k = 0; k < DRAGON_KERNELS; k++) {
+        if (!strcmp(name, dragon_kernels[k].name)) {
+            if (!dragon_cpu_supports(dragon_kernels[k].cpu)) {
+                return -1;
+            }
+            if (dragon_kernels[k].init && dragon_kernels[k].init() != 0) {
+                return -1;
+            }
+            atomic_store_explicit(&dragon_active_kernel, &dragon_kernels[k],
+                                  memory_order_release);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @return name of the bound kernel
+ */
+const char* DRAGON_kernel_name(void)
+{
+    return dragon_bound_kernel()->name;
+}
+
+/**
+ * Generate #(blocks) 64-bit blocks of keystream for each of #(streams)
+ * streams with the bound kernel.
+ */
+void DRAGON_keystream_blocks_multi(
+  ECRYPT_ctx** ctx,
+  u8** keystream,
+  u32 streams,
+  u32 blocks)
+{
+    assert(ctx && keystream);
+
+    dragon_bound_kernel()->multi(ctx, NULL, keystream, streams, blocks);
+}
+
+/**
+ * Encrypt/Decrypt #(blocks) 64-bit blocks of text for each of
+ * #(streams) streams with the bound kernel.
+ */
+void DRAGON_process_blocks_multi(
+  int action,                 /* 0 = encrypt; 1 = decrypt; */
+  ECRYPT_ctx** ctx,
+  const u8** input,
+  u8** output,
+  u32 streams,
+  u32 blocks)
+{
+    assert(ctx && input && output);
+
+    dragon_bound_kernel()->multi(ctx, input, output, streams, blocks);
+}
+
+/**
+ * IV setup of #(streams) streams with the bound kernel.
+ */
+void DRAGON_ivsetup_multi(
+  ECRYPT_ctx** ctx,
+  const u8** iv,
+  u32 streams)
+{
+    assert(ctx && iv);
+
+    dragon_bound_kernel()->ivsetup(ctx, iv, streams);
+}
@@ -0,0 +1,132 @@
+/**
+ * @file dragon-dispatch.h
+ * Kernel table behind the Dragon block functions (internal)
+ * This source is provided without warranty
+ * or guarantee of any kind. Use at your own risk.
+ */
+#ifndef DRAGON_DISPATCH
+#define DRAGON_DISPATCH
+
+#include <stdatomic.h>
+
+#include "dragon-multi.h"
+
+/**
+ * A kernel provides a single-stream block function, used by
+ * ECRYPT_keystream_blocks() and ECRYPT_process_blocks() (a scalar one
+ * for every kernel; the SIMD kernels only differ in the rest), and a
+ * multi-stream block function taking any number of streams, used by
+ * DRAGON_keystream_blocks_multi() and DRAGON_process_blocks_multi().
+ * A kernel may also run 16 streams straight from the structure-of-arrays
+ * layout of a dragon_bank. A NULL input selects keystream generation.
+ */
+typedef struct
+{
+    const char* name;
+    const char* cpu;          /* required CPU feature, NULL for none */
+    int  (*init)(void);       /* builds kernel tables, NULL for none */
+    void (*blocks)(
+      ECRYPT_ctx* ctx,
+      const u8* input,
+      u8* output,
+      u32 blocks);
+    void (*multi)(
+      ECRYPT_ctx** ctx,
+      const u8** input,
+      u8** output,
+      u32 streams,
+      u32 blocks);
+    void (*ivsetup)(          /* IV setup of any number of streams */
+      ECRYPT_ctx** ctx,
+      const u8** iv,
+      u32 streams);
+    void (*bank)(             /* 16 streams in SoA layout, NULL for none */
+      u32* nlfsr,
+      u32 stride,
+      u32* counter1,
+      u32* counter2,
+      u32 active,
+      const u8** input,
+      u8** output,
+      u32 blocks);
+} dragon_kernel;
+
+/* The kernel bound by ECRYPT_init(); the scalar kernel until then.
+   Written with release, read through dragon_bound_kernel() */
+extern _Atomic(const dragon_kernel*) dragon_active_kernel;
+
+/*
+ * The bound kernel. The acquire load pairs with the release store of
+ * the binding, so the tables built by the kernel's init are visible.
+ */
+static inline const dragon_kernel* dragon_bound_kernel(void)
+{
+    return atomic_load_explicit(&dragon_active_kernel, memory_order_acquire);
+}
+
+/* Probes the CPU and binds dragon_active_kernel, once even if called
+   from several threads. Called by ECRYPT_init() */
+void dragon_dispatch_init(void);
+
+/* IV setup of dragon-opt.c, split around the mixing stages so that
+   the SIMD kernels can mix several NLFSRs at once */
+#define DRAGON_MIXING_STAGES   16 /* number of mixes during initialization */
+#define DRAGON_MIX_E           0x00004472 /* initial counter, high word */
+#define DRAGON_MIX_F           0x61676F6E /* initial counter, low word */
+
+void dragon_iv_load(
+  ECRYPT_ctx* ctx,
+  const u8* iv);
+
+void dragon_iv_done(
+  ECRYPT_ctx* ctx,
+  u32 e,
+  u32 f);
+
+/* Single-stream scalar block kernel of dragon-opt.c */
+void dragon_scalar_blocks(
+  ECRYPT_ctx* ctx,
+  const u8* input,
+  u8* output,
+  u32 blocks);
+
+/* Scalar block kernel over 16-bit s-box tables, see dragon-wide.c */
+int dragon_wide_init(void);
+
+void dragon_wide_blocks(
+  ECRYPT_ctx* ctx,
+  const u8* input,
+  u8* output,
+  u32 blocks);
+
+/* Scalar block kernel over the interleaved s-box table, see dragon-packed.c */
+void dragon_packed_blocks(
+  ECRYPT_ctx* ctx,
+  const u8* input,
+  u8* output,
+  u32 blocks);
+
+/* 16-lane kernels over the structure-of-arrays layout of a dragon_bank,
+   see dragon-avx512.c: word j of lane l at nlfsr[j * stride + l], lanes
+   outside the active mask are neither read nor written */
+void dragon_x16_soa_blocks(
+  u32* nlfsr,
+  u32 stride,
+  u32* counter1,
+  u32* counter2,
+  u32 active,
+  const u8** input,
+  u8** output,
+  u32 blocks);
+
+void dragon_x16_soa_blocks_perm(
+  u32* nlfsr,
+  u32 stride,
+  u32* counter1,
+  u32* counter2,
+  u32 active,
+  const u8** input,
+  u8** output,
+  u32 blocks);
+
+#endif
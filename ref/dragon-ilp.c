@@ -0,0 +1,173 @@
+/**
+ * @file dragon-ilp.c
+ * Interleaved scalar implementation of Dragon, 2 to 4 streams at once
+ * This source is provided without warranty
+ * or guarantee of any kind. Use at your own risk.
+ */
+#include <assert.h>
+
+#include "dragon-multi.h"
+#include "dragon-sboxes.c"
+#include "dragon-schedule.h"
+
+/**
+ * A single Dragon round is one long dependency chain. Running the same
+ * round on several independent streams, layer by layer, gives the CPU
+ * 2 to 4 chains to overlap so that the s-box loads of one stream can
+ * hide the latency of another. Whether that pays depends on the core:
+ * it needs more load ports and registers than the scalar kernel, and
+ * with 4 streams the state spills. The ILP_Xn macros apply a per-stream
+ * macro M to streams 0..n-1; the variables of stream s carry the
+ * suffix s.
+ */
+#define ILP_X1(M, ...) M(0, __VA_ARGS__)
+#define ILP_X2(M, ...) ILP_X1(M, __VA_ARGS__) M(1, __VA_ARGS__)
+#define ILP_X3(M, ...) ILP_X2(M, __VA_ARGS__) M(2, __VA_ARGS__)
+#define ILP_X4(M, ...) ILP_X3(M, __VA_ARGS__) M(3, __VA_ARGS__)
+
+#define ILP_DECL(s, ctx) \
+    u32 *nlfsr##s = ctx[s]->nlfsr_word; \
+    u32 a##s, b##s, c##s, d##s, e##s, f##s; \
+    u32 c1_##s = ctx[s]->state_counter[0]; \
+    u32 c2_##s = ctx[s]->state_counter[1]; \
+    u32 ks##s[32] __attribute__((aligned(32))); \
+    u32 *k##s; \
+    const u8 *in##s = input ? input[s] : NULL; \
+    u8 *out##s = output[s];
+
+#define ILP_SAVE(s, ctx) \
+    ctx[s]->state_counter[0] = c1_##s; \
+    ctx[s]->state_counter[1] = c2_##s;
+
+/* Pre-mixing layer of BASIC_RND; the counter carry is propagated per block */
+#define ILP_PREMIX(s, loc_a, loc_b, loc_c, loc_d, loc_e) \
+    a##s = nlfsr##s[loc_a]; \
+    c##s = nlfsr##s[loc_c]; \
+    e##s = nlfsr##s[loc_e] ^ c1_##s; \
+    b##s = nlfsr##s[loc_b] ^ a##s; \
+    d##s = nlfsr##s[loc_d] ^ c##s; \
+    f##s = (nlfsr##s[loc_e+1] ^ e##s) ^ (c2_##s++); \
+    c1_##s += (c2_##s == 0); \
+    c##s += b##s; \
+    e##s += d##s; \
+    a##s += f##s;
+
+#define ILP_GLAYER(s, unused) \
+    f##s ^= G2(c##s); b##s ^= G3(e##s); d##s ^= G1(a##s);
+
+#define ILP_HLAYER(s, unused) \
+    e##s ^= H3(f##s); a##s ^= H1(b##s); c##s ^= H2(d##s);
+
+#define ILP_FEEDBACK(s, loc_fb1) \
+    nlfsr##s[loc_fb1] = b##s + e##s; \
+    nlfsr##s[loc_fb1+1] = c##s ^ (b##s + e##s);
+
+/* Keystream words go to the aligned buffer of the stream in host order */
+#define ILP_KEYSTREAM(s, unused) \
+    *(k##s++) = a##s ^ (f##s + c##s); \
+    *(k##s++) = e##s ^ (d##s + a##s);
+
+#define ILP_START(s, unused) \
+    k##s = ks##s;
+
+/* As in DRAGON_DEFINE_BLOCKS, the text may start at any address */
+#define ILP_STORE(s, unused) \
+    dragon_xor_be32(out##s, in##s, ks##s, sizeof(ks##s)); \
+    in##s = in##s ? in##s + sizeof(ks##s) : NULL; \
+    out##s += sizeof(ks##s);
+
+/**
+ * ILP_RND runs one round on every stream, in the slot of the
+ * DRAGON_16RND schedule given by the locations.
+ */
+#define ILP_RND(EACH, a, loc_a, b, loc_b, c, loc_c, \
+                      d, loc_d, e, loc_e, f, loc_fb1, c1, c2, OUT, out) \
+    EACH(ILP_PREMIX, loc_a, loc_b, loc_c, loc_d, loc_e) \
+    EACH(ILP_GLAYER, 0) \
+    EACH(ILP_HLAYER, 0) \
+    EACH(ILP_FEEDBACK, loc_fb1) \
+    EACH(OUT, 0)
+
+#define ILP_DEFINE(name, EACH) \
+static void name( \
+  ECRYPT_ctx** ctx, \
+  const u8** input, \
+  u8** output, \
+  u32 blocks) \
+{ \
+    EACH(ILP_DECL, ctx) \
+    while (blocks > 0) { \
+        EACH(ILP_START, 0) \
+        DRAGON_16RND(ILP_RND, EACH, a, b, c, d, e, f, c1, c2, ILP_KEYSTREAM, k) \
+        EACH(ILP_STORE, 0) \
+        blocks -= 16; \
+    } \
+    EACH(ILP_SAVE, ctx) \
+}
+
+/* A NULL input selects keystream generation */
+ILP_DEFINE(dragon_ilp2, ILP_X2)
+ILP_DEFINE(dragon_ilp3, ILP_X3)
+ILP_DEFINE(dragon_ilp4, ILP_X4)
+
+/**
+ * Generate #(blocks) 64-bit blocks of keystream for each of #(streams)
+ * streams. Streams are run in groups of up to DRAGON_ILP_WAYS.
+ * @param  ctx        [In/Out]  distinct Dragon contexts
+ * @param  keystream  [Out]     pre-allocated arrays of 8*(blocks) bytes
+ * @param  streams    [In]      number of streams
+ * @param  blocks     [In]      number of keystream blocks per stream,
+ *                              a multiple of 16
+ */
+void DRAGON_keystream_blocks_ilp(
+  ECRYPT_ctx** ctx,
+  u8** keystream,
+  u32 streams,
+  u32 blocks)
+{
+    assert(ctx && keystream);
+    assert(blocks % 16 == 0);
+
+    while (streams >= 4) {
+        dragon_ilp4(ctx, NULL, keystream, blocks);
+        ctx += 4, keystream += 4, streams -= 4;
+    }
+    switch (streams) {
+    case 3: dragon_ilp3(ctx, NULL, keystream, blocks); break;
+    case 2: dragon_ilp2(ctx, NULL, keystream, blocks); break;
+    case 1: ECRYPT_keystream_blocks(ctx[0], keystream[0], blocks); break;
+    }
+}
+
+/**
+ * Encrypt/Decrypt #(blocks) 64-bit blocks of text for each of #(streams)
+ * streams. Streams are run in groups of up to DRAGON_ILP_WAYS.
+ * @param  action   [In]      This parameter has no meaning for Dragon
+ * @param  ctx      [In/Out]  distinct Dragon contexts
+ * @param  input    [In]      arrays of (plain/cipher)text blocks
+ * @param  output   [Out]     pre-allocated arrays of 8*(blocks) bytes
+ * @param  streams  [In]      number of streams
+ * @param  blocks   [In]      number of blocks per stream, a multiple of 16
+ */
+void DRAGON_process_blocks_ilp(
+  int action,                 /* 0 = encrypt; 1 = decrypt; */
+  ECRYPT_ctx** ctx,
+  const u8** input,
+  u8** output,
+  u32 streams,
+  u32 blocks)
+{
+    assert(ctx && input && output);
+    assert(blocks % 16 == 0);
+
+    while (streams >= 4) {
+        dragon_ilp4(ctx, input, output, blocks);
+        ctx += 4, input += 4, output += 4, streams -= 4;
+    }
+    switch (streams) {
+    case 3: dragon_ilp3(ctx, input, output, blocks); break;
+    case 2: dragon_ilp2(ctx, input, output, blocks); break;
+    case 1: ECRYPT_process_blocks(action, ctx[0], input[0], output[0], blocks);
+            break;
+    }
+}
@@ -0,0 +1,67 @@
+/**
+ * @file dragon-iov.c
+ * Scatter/gather encryption with Dragon
+ * This source is provided without warranty
+ * or guarantee of any kind. Use at your own risk.
+ */
+#include <assert.h>
+
+#include "dragon-iov.h"
+#include "dragon-multi.h"
+
+static size_t dragon_iov_length(const struct iovec* v, int n)
+{
+    size_t total = 0;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        total += v[i].iov_len;
+    }
+    return total;
+}
+
+/*
+ * Walk both chains at once, processing the overlap of the current input
+ * and output segments in one call each.
+ */
+int DRAGON_process_iov(
+  int action,                 /* 0 = encrypt; 1 = decrypt; */
+  ECRYPT_ctx* ctx,
+  const struct iovec* in,
+  int n_in,
+  const struct iovec* out,
+  int n_out)
+{
+    size_t in_pos = 0, out_pos = 0;
+    size_t n;
+    int i = 0, o = 0;
+
+    assert(ctx && (in || n_in == 0) && (out || n_out == 0));
+
+    if (dragon_iov_length(in, n_in) != dragon_iov_length(out, n_out)) {
+        return -1;
+    }
+
+    while (i < n_in && o < n_out) {
+        if (in_pos == in[i].iov_len) {
+            i++;
+            in_pos = 0;
+            continue;
+        }
+        if (out_pos == out[o].iov_len) {
+            o++;
+            out_pos = 0;
+            continue;
+        }
+        n = in[i].iov_len - in_pos;
+        if (n > out[o].iov_len - out_pos) {
+            n = out[o].iov_len - out_pos;
+        }
+        DRAGON_process_bytes_long(action, ctx,
+                                  (const u8*)in[i].iov_base + in_pos,
+                                  (u8*)out[o].iov_base + out_pos, n);
+        in_pos += n;
+        out_pos += n;
+    }
+    return 0;
+}
@@ -0,0 +1,46 @@
+/**
+ * @file dragon-iov.h
+ * Scatter/gather encryption with Dragon
+ * This source is provided without warranty
+ * or guarantee of any kind. Use at your own risk.
+ */
+#ifndef DRAGON_IOV
+#define DRAGON_IOV
+
+#ifndef _DRAGON_OPT
+#define _DRAGON_OPT
+#endif
+
+#include <sys/uio.h>
+
+#include "ecrypt-sync.h"
+
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Encrypt/Decrypt the bytes of an iovec chain into another, continuing
+ * the stream as ECRYPT_process_bytes() does. The chains may split the
+ * text at different places, and segments may start at any address and
+ * have any length: partial blocks carry across segment boundaries in
+ * the context's keystream buffer, and nothing is copied to linearise
+ * the text. The chains may describe the same memory.
+ * @param  action  [In]      This parameter has no meaning for Dragon
+ * @param  ctx     [In/Out]  Dragon context
+ * @param  in      [In]      (plain/cipher)text segments
+ * @param  n_in    [In]      number of input segments
+ * @param  out     [In]      pre-allocated output segments
+ * @param  n_out   [In]      number of output segments
+ * @return 0 on success, -1 if the chains differ in total length, in
+ *         which case nothing is processed
+ */
+int DRAGON_process_iov(
+  int action,                 /* 0 = encrypt; 1 = decrypt; */
+  ECRYPT_ctx* ctx,
+  const struct iovec* in,
+  int n_in,
+  const struct iovec* out,
+  int n_out);
+
+/* ------------------------------------------------------------------------- */
+
+#endif
@@ -0,0 +1,341 @@
+/**
+ * @file dragon-multi.h
+ * Multi-stream extensions to the ECRYPT Dragon API
+ * This source is provided without warranty
+ * or guarantee of any kind. Use at your own risk.
+ */
+#ifndef DRAGON_MULTI
+#define DRAGON_MULTI
+
+/* The multi-stream kernels operate on the optimised context layout */
+#ifndef _DRAGON_OPT
+#define _DRAGON_OPT
+#endif
+
+#include "ecrypt-sync.h"
+
+/* ------------------------------------------------------------------------- */
+
+/* Kernel dispatch. ECRYPT_init() probes the CPU once and binds the
+   fastest supported multi-stream kernel to the functions below. The
+   rounds of one stream form a single dependency chain, so SIMD only
+   helps across streams: ECRYPT_keystream_blocks() and
+   ECRYPT_process_blocks() run the scalar kernel under every automatic
+   choice, and only "scalar-wide" or "scalar-packed" replace it there.
+   Setting the environment variable DRAGON_KERNEL to one of "scalar",
+   "ilp", "avx2", "avx512", "avx512-perm", "scalar-wide" or
+   "scalar-packed" forces that kernel instead, if supported; any other
+   value is reported once on stderr and ignored.
+   ECRYPT_init() and DRAGON_select_kernel() may run in any thread at any
+   time: the binding is one atomic pointer, and each call of a block or
+   multi-stream function runs entirely with the kernel bound when it
+   started. Contexts themselves are not shared between threads.
+   "scalar-wide" evaluates each G/H function with two lookups into 1 MiB
+   of 16-bit indexed tables, built when selected. "scalar-packed" reads
+   sbox1[i] and sbox2[i] from one interleaved, cache-line aligned
+   table. */
+
+/**
+ * Bind the named kernel.
+ * @param  name  [In]  kernel name
+ * @return 0 on success, -1 if the kernel is unknown, not supported
+ *         by this CPU, or its tables cannot be built
+ */
+int DRAGON_select_kernel(const char* name);
+
+/**
+ * @return name of the bound kernel
+ */
+const char* DRAGON_kernel_name(void);
+
+/**
+ * Generate #(blocks) 64-bit blocks of keystream for each of #(streams)
+ * streams with the bound kernel.
+ * @param  ctx        [In/Out]  distinct Dragon contexts
+ * @param  keystream  [Out]     pre-allocated arrays of 8*(blocks) bytes
+ * @param  streams    [In]      number of streams
+ * @param  blocks     [In]      number of keystream blocks per stream,
+ *                              a multiple of 16
+ */
+void DRAGON_keystream_blocks_multi(
+  ECRYPT_ctx** ctx,
+  u8** keystream,
+  u32 streams,
+  u32 blocks);
+
+/**
+ * Encrypt/Decrypt #(blocks) 64-bit blocks of text for each of #(streams)
+ * streams with the bound kernel.
+ * @param  action   [In]      This parameter has no meaning for Dragon
+ * @param  ctx      [In/Out]  distinct Dragon contexts
+ * @param  input    [In]      arrays of (plain/cipher)text blocks
+ * @param  output   [Out]     pre-allocated arrays of 8*(blocks) bytes
+ * @param  streams  [In]      number of streams
+ * @param  blocks   [In]      number of blocks per stream, a multiple of 16
+ */
+void DRAGON_process_blocks_multi(
+  int action,                 /* 0 = encrypt; 1 = decrypt; */
+  ECRYPT_ctx** ctx,
+  const u8** input,
+  u8** output,
+  u32 streams,
+  u32 blocks);
+
+/**
+ * IV setup of #(streams) streams with the bound kernel: 8 or 16 at a
+ * time with the SIMD kernels, one by one otherwise. Equivalent to
+ * ECRYPT_ivsetup() on each context.
+ * @param  ctx      [In/Out]  distinct Dragon contexts after ECRYPT_keysetup()
+ * @param  iv       [In]      IVs
+ * @param  streams  [In]      number of streams
+ */
+void DRAGON_ivsetup_multi(
+  ECRYPT_ctx** ctx,
+  const u8** iv,
+  u32 streams);
+
+/* ------------------------------------------------------------------------- */
+
+/* Long messages. The ECRYPT functions take 32-bit lengths; these take a
+   size_t, so that a whole multi-GiB buffer, such as a mapped file, goes
+   in one call. The 64-bit block counter carries inside the kernels, at
+   any length. */
+
+#include <stddef.h>
+
+/**
+ * Generate #(length) bytes of keystream, as ECRYPT_keystream_bytes().
+ * @param  ctx        [In/Out]  Dragon context
+ * @param  keystream  [Out]     pre-allocated array of (length) bytes
+ * @param  length     [In]      number of bytes
+ */
+void DRAGON_keystream_bytes_long(
+  ECRYPT_ctx* ctx,
+  u8* keystream,
+  size_t length);
+
+/**
+ * Encrypt/Decrypt #(msglen) bytes, as ECRYPT_process_bytes().
+ * @param  action  [In]      This parameter has no meaning for Dragon
+ * @param  ctx     [In/Out]  Dragon context
+ * @param  input   [In]      (plain/cipher)text
+ * @param  output  [Out]     pre-allocated array of (msglen) bytes
+ * @param  msglen  [In]      number of bytes
+ */
+void DRAGON_process_bytes_long(
+  int action,                 /* 0 = encrypt; 1 = decrypt; */
+  ECRYPT_ctx* ctx,
+  const u8* input,
+  u8* output,
+  size_t msglen);
+
+/**
+ * Generate #(blocks) 64-bit blocks of keystream, as
+ * ECRYPT_keystream_blocks().
+ * @param  ctx        [In/Out]  Dragon context
+ * @param  keystream  [Out]     pre-allocated array of 8*(blocks) bytes
+ * @param  blocks     [In]      number of blocks
+ */
+void DRAGON_keystream_blocks_long(
+  ECRYPT_ctx* ctx,
+  u8* keystream,
+  size_t blocks);
+
+/**
+ * Encrypt/Decrypt #(blocks) 64-bit blocks of text, as
+ * ECRYPT_process_blocks().
+ * @param  action  [In]      This parameter has no meaning for Dragon
+ * @param  ctx     [In/Out]  Dragon context
+ * @param  input   [In]      (plain/cipher)text blocks
+ * @param  output  [Out]     pre-allocated array of 8*(blocks) bytes
+ * @param  blocks  [In]      number of blocks
+ */
+void DRAGON_process_blocks_long(
+  int action,                 /* 0 = encrypt; 1 = decrypt; */
+  ECRYPT_ctx* ctx,
+  const u8* input,
+  u8* output,
+  size_t blocks);
+
+/* Batched packets: many (IV, message) pairs under one key per call. The
+   whole 16-block groups of up to DRAGON_PACKET_LANES packets at a time
+   run through the bound multi-stream kernel. */
+
+#define DRAGON_PACKET_LANES   16
+
+/**
+ * Encrypt/Decrypt #(packets) packets, each under its own IV.
+ * @param  action   [In]  This parameter has no meaning for Dragon
+ * @param  ctx      [In]  Dragon context after ECRYPT_keysetup()
+ * @param  iv       [In]  array of IVs
+ * @param  input    [In]  array of (plain/cipher)texts
+ * @param  output   [Out] array of pre-allocated (cipher/plain)text buffers
+ * @param  msglen   [In]  array of message lengths in bytes
+ * @param  packets  [In]  number of packets
+ */
+void DRAGON_process_packets(
+  int action,                 /* 0 = encrypt; 1 = decrypt; */
+  const ECRYPT_ctx* ctx,
+  const u8** iv,
+  const u8** input,
+  u8** output,
+  const u32* msglen,
+  u32 packets);
+
+/* ------------------------------------------------------------------------- */
+
+/* Interleaved scalar kernel: 2 to 4 streams per call of the round
+   schedule, for CPUs without fast gathers. Any number of streams may be
+   passed; they are run in groups of up to DRAGON_ILP_WAYS. */
+
+#define DRAGON_ILP_WAYS        4
+
+/**
+ * Generate #(blocks) 64-bit blocks of keystream for each of #(streams)
+ * streams.
+ * @param  ctx        [In/Out]  distinct Dragon contexts
+ * @param  keystream  [Out]     pre-allocated arrays of 8*(blocks) bytes
+ * @param  streams    [In]      number of streams
+ * @param  blocks     [In]      number of keystream blocks per stream,
+ *                              a multiple of 16
+ */
+void DRAGON_keystream_blocks_ilp(
+  ECRYPT_ctx** ctx,
+  u8** keystream,
+  u32 streams,
+  u32 blocks);
+
+/**
+ * Encrypt/Decrypt #(blocks) 64-bit blocks of text for each of #(streams)
+ * streams.
+ * @param  action   [In]      This parameter has no meaning for Dragon
+ * @param  ctx      [In/Out]  distinct Dragon contexts
+ * @param  input    [In]      arrays of (plain/cipher)text blocks
+ * @param  output   [Out]     pre-allocated arrays of 8*(blocks) bytes
+ * @param  streams  [In]      number of streams
+ * @param  blocks   [In]      number of blocks per stream, a multiple of 16
+ */
+void DRAGON_process_blocks_ilp(
+  int action,                 /* 0 = encrypt; 1 = decrypt; */
+  ECRYPT_ctx** ctx,
+  const u8** input,
+  u8** output,
+  u32 streams,
+  u32 blocks);
+
+/* ------------------------------------------------------------------------- */
+
+/* AVX2 kernel: 8 independent streams, one per 32-bit lane */
+
+#define DRAGON_AVX2_LANES      8
+
+/**
+ * Generate #(blocks) 64-bit blocks of keystream for each of 8 streams.
+ * Every lane produces exactly what ECRYPT_keystream_blocks() would
+ * produce for its context.
+ * @param  ctx        [In/Out]  8 distinct Dragon contexts
+ * @param  keystream  [Out]     8 pre-allocated arrays of 8*(blocks) bytes
+ * @param  blocks     [In]      number of keystream blocks per stream,
+ *                              a multiple of 16
+ */
+void DRAGON_keystream_blocks_x8(
+  ECRYPT_ctx* ctx[DRAGON_AVX2_LANES],
+  u8* keystream[DRAGON_AVX2_LANES],
+  u32 blocks);
+
+/**
+ * Encrypt/Decrypt #(blocks) 64-bit blocks of text for each of 8 streams.
+ * @param  action  [In]      This parameter has no meaning for Dragon
+ * @param  ctx     [In/Out]  8 distinct Dragon contexts
+ * @param  input   [In]      8 arrays of (plain/cipher)text blocks
+ * @param  output  [Out]     8 pre-allocated arrays of 8*(blocks) bytes
+ * @param  blocks  [In]      number of blocks per stream, a multiple of 16
+ */
+void DRAGON_process_blocks_x8(
+  int action,                 /* 0 = encrypt; 1 = decrypt; */
+  ECRYPT_ctx* ctx[DRAGON_AVX2_LANES],
+  const u8* input[DRAGON_AVX2_LANES],
+  u8* output[DRAGON_AVX2_LANES],
+  u32 blocks);
+
+/**
+ * IV setup of up to 8 streams, mixing all NLFSRs in parallel.
+ * Equivalent to ECRYPT_ivsetup() on each context.
+ * @param  ctx  [In/Out]  8 distinct Dragon contexts after
+ *                        ECRYPT_keysetup(), NULL for idle lanes
+ * @param  iv   [In]      8 IVs
+ */
+void DRAGON_ivsetup_x8(
+  ECRYPT_ctx* ctx[DRAGON_AVX2_LANES],
+  const u8* iv[DRAGON_AVX2_LANES]);
+
+/* ------------------------------------------------------------------------- */
+
+/* AVX-512 kernel: 16 independent streams, one per 32-bit lane. Lanes
+   may run for different numbers of blocks; finished or unused lanes are
+   masked off rather than handed to the scalar code. */
+
+#define DRAGON_AVX512_LANES   16
+
+/**
+ * Generate blocks[lane] 64-bit blocks of keystream for each of 16 streams.
+ * @param  ctx        [In/Out]  16 distinct Dragon contexts, NULL for
+ *                              idle lanes
+ * @param  keystream  [Out]     16 pre-allocated arrays of
+ *                              8*(blocks[lane]) bytes
+ * @param  blocks     [In]      number of keystream blocks per stream,
+ *                              each a multiple of 16
+ */
+void DRAGON_keystream_blocks_x16(
+  ECRYPT_ctx* ctx[DRAGON_AVX512_LANES],
+  u8* keystream[DRAGON_AVX512_LANES],
+  const u32 blocks[DRAGON_AVX512_LANES]);
+
+/**
+ * Encrypt/Decrypt blocks[lane] 64-bit blocks of text for each of 16
+ * streams.
+ * @param  action  [In]      This parameter has no meaning for Dragon
+ * @param  ctx     [In/Out]  16 distinct Dragon contexts, NULL for idle lanes
+ * @param  input   [In]      16 arrays of (plain/cipher)text blocks
+ * @param  output  [Out]     16 pre-allocated arrays of 8*(blocks[lane]) bytes
+ * @param  blocks  [In]      number of blocks per stream, each a multiple
+ *                           of 16
+ */
+void DRAGON_process_blocks_x16(
+  int action,                 /* 0 = encrypt; 1 = decrypt; */
+  ECRYPT_ctx* ctx[DRAGON_AVX512_LANES],
+  const u8* input[DRAGON_AVX512_LANES],
+  u8* output[DRAGON_AVX512_LANES],
+  const u32 blocks[DRAGON_AVX512_LANES]);
+
+/*
+ * Variants of the 16-lane kernel that keep both 256-entry s-boxes in
+ * zmm registers and resolve lookups with vpermi2d selects. They make
+ * no data-dependent memory accesses.
+ */
+void DRAGON_keystream_blocks_x16_perm(
+  ECRYPT_ctx* ctx[DRAGON_AVX512_LANES],
+  u8* keystream[DRAGON_AVX512_LANES],
+  const u32 blocks[DRAGON_AVX512_LANES]);
+
+void DRAGON_process_blocks_x16_perm(
+  int action,                 /* 0 = encrypt; 1 = decrypt; */
+  ECRYPT_ctx* ctx[DRAGON_AVX512_LANES],
+  const u8* input[DRAGON_AVX512_LANES],
+  u8* output[DRAGON_AVX512_LANES],
+  const u32 blocks[DRAGON_AVX512_LANES]);
+
+/**
+ * IV setup of up to 16 streams, mixing all NLFSRs in parallel.
+ * Equivalent to ECRYPT_ivsetup() on each context.
+ * @param  ctx  [In/Out]  16 distinct Dragon contexts after
+ *                        ECRYPT_keysetup(), NULL for idle lanes
+ * @param  iv   [In]      16 IVs
+ */
+void DRAGON_ivsetup_x16(
+  ECRYPT_ctx* ctx[DRAGON_AVX512_LANES],
+  const u8* iv[DRAGON_AVX512_LANES]);
+
+/* ------------------------------------------------------------------------- */
+
+#endif
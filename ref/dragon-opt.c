@@ -6,11 +6,18 @@
  * @author Information Security Institute
  */
 #include <assert.h>
+#include <stddef.h>
+#include <string.h>
 
 #define _DRAGON_OPT
 
 #include "ecrypt-sync.h"
+#include "dragon-dispatch.h"
 #include "dragon-sboxes.c"
+#include "dragon-schedule.h"
+
+/* Largest block count passed to a kernel at once: a multiple of 16 */
+#define DRAGON_BLOCKS_MAX  0x10000000
 
 /**
  * The DRAGON_OFFSET macro calculates the position of the 
@@ -42,6 +49,9 @@
  */
 void ECRYPT_init(void)
 {
+    /* bind the multi-stream functions to the best kernel for this CPU;
+       single streams stay on a scalar kernel */
+    dragon_dispatch_init();
 }
 
 /*
@@ -117,25 +127,16 @@ void ECRYPT_keysetup(
     }
 }
 
-#define DRAGON_MIXING_STAGES   16 /* number of mixes during initialization */
-
 /*
- * IV setup. After having called ECRYPT_keysetup(), the user is
- * allowed to call ECRYPT_ivsetup() different times in order to
- * encrypt/decrypt different messages with the same key but different
- * IV's.
+ * First half of the IV setup: restore the post-keysetup NLFSR if this
+ * is a rekeying, and inject the IV. The mixing stages follow.
  */
-void ECRYPT_ivsetup(
+void dragon_iv_load(
     ECRYPT_ctx* ctx,
     const u8* iv)
 {
-    u32 a, b, c, d;
-    u32 e = 0x00004472;
-    u32 f = 0x61676F6E;
     u32 iv_word;
     u32 idx;
-    
-    assert(ctx && iv);
 
     /**
       * This is either a continuation of key initialization,
@@ -197,7 +198,48 @@ void ECRYPT_ivsetup(
             ctx->nlfsr_word[24 + idx]  = iv_word;
         }
     }
+}
+
+/*
+ * Last step of the IV setup, with the counter (e, f) left by the mixing
+ * stages. The 16 stages move the ring by 16*28 words, a multiple of its
+ * size, so the NLFSR is back at location 0.
+ */
+void dragon_iv_done(
+    ECRYPT_ctx* ctx,
+    u32 e,
+    u32 f)
+{
+    ctx->nlfsr_offset = 0;
+    ctx->state_counter[0] = e;
+    ctx->state_counter[1] = f;
+
+    /* Keystream buffered for the previous IV is void */
+    ctx->buffer_index = 0;
+
+    /* Assume that the next keying operation will be IV only */
+    ctx->full_rekeying = 0 ;
+}
+
+/*
+ * IV setup. After having called ECRYPT_keysetup(), the user is
+ * allowed to call ECRYPT_ivsetup() different times in order to
+ * encrypt/decrypt different messages with the same key but different
+ * IV's.
+ */
+void ECRYPT_ivsetup(
+    ECRYPT_ctx* ctx,
+    const u8* iv)
+{
+    u32 a, b, c, d;
+    u32 e = DRAGON_MIX_E;
+    u32 f = DRAGON_MIX_F;
+    u32 idx;
     
+    assert(ctx && iv);
+
+    dragon_iv_load(ctx, iv);
+
     /** Iterate mixing process */
     for (idx = 0; idx < DRAGON_MIXING_STAGES; idx++) {
         a = DRAGON_NLFSR_WORD(ctx, 0)  ^ 
@@ -225,66 +267,19 @@ void ECRYPT_ivsetup(
         DRAGON_NLFSR_WORD(ctx, 2) = c ^ DRAGON_NLFSR_WORD(ctx, 22);
         DRAGON_NLFSR_WORD(ctx, 3) = d ^ DRAGON_NLFSR_WORD(ctx, 23);
     }
-    ctx->state_counter[0] = e;
-    ctx->state_counter[1] = f;
-
-    /* Assume that the next keying operation will be IV only */
-    ctx->full_rekeying = 0 ;
+    dragon_iv_done(ctx, e, f);
 }
 
 /**
- * DRAGON_ROUND produces one block of keystream
- */
-#define BASIC_RND(ctx, a, loc_a, b, loc_b, c, loc_c, \
-                         d, loc_d, e, loc_e, f, loc_fb1, c1, c2)\
-    a = ctx->nlfsr_word[loc_a]; \
-    c = ctx->nlfsr_word[loc_c]; \
-    e = ctx->nlfsr_word[loc_e] ^ c1; \
-    b = ctx->nlfsr_word[loc_b] ^ a; \
-    d = ctx->nlfsr_word[loc_d] ^ c; \
-    f = (ctx->nlfsr_word[loc_e+1] ^ e) ^ (c2++); \
-    c += b; \
-    e += d; \
-    a += f; \
-    f ^= G2(c); b ^= G3(e); d ^= G1(a); \
-    e ^= H3(f); a ^= H1(b); c ^= H2(d); \
-    ctx->nlfsr_word[loc_fb1] = b + e;  \
-    ctx->nlfsr_word[loc_fb1+1] = c ^ (b + e); 
-
-#define KEYSTREAM_RND(ctx, a, loc_a, b, loc_b, c, loc_c, \
-                         d, loc_d, e, loc_e, f, loc_fb1, c1, c2, in, out)\
-    BASIC_RND(ctx, a, loc_a, b, loc_b, c, loc_c, \
-       d, loc_d, e, loc_e, f, loc_fb1, c1, c2) \
-    *(out++) = U32TO32_BIG(a ^ (f + c)); \
-    *(out++) = U32TO32_BIG(e ^ (d + a));  
-
-#define PROCESS_RND(ctx, a, loc_a, b, loc_b, c, loc_c, \
-                         d, loc_d, e, loc_e, f, loc_fb1, c1, c2, in, out)\
-    BASIC_RND(ctx, a, loc_a, b, loc_b, c, loc_c, \
-       d, loc_d, e, loc_e, f, loc_fb1, c1, c2) \
-    *(out++) = *(in++) ^ a ^ (f + c); \
-    *(out++) = *(in++) ^ e ^ (d + a);  
- 
-/** 
- * DRAGON_ROUND produces 16 blocks of keystream
+ * Scalar block kernel: run #(blocks) rounds, writing the keystream to
+ * output, or input XOR keystream when input is not NULL. The buffers
+ * may start at any address, and output may equal input.
+ * @param  ctx     [In/Out]  Dragon context
+ * @param  input   [In]      (plain/cipher)text blocks, or NULL
+ * @param  output  [Out]     pre-allocated array of 8*(blocks) bytes
+ * @param  blocks  [In]      number of blocks
  */
-#define DRAGON_16RND(RND, ctx, a, b, c, d, e, f, c1, c2, in, out) \
-  RND(ctx, a,  0, b,  9, c, 16, d, 19, e, 30, f, 30, c1, c2, in, out) \
-  RND(ctx, a, 30, b,  7, c, 14, d, 17, e, 28, f, 28, c1, c2, in, out) \
-  RND(ctx, a, 28, b,  5, c, 12, d, 15, e, 26, f, 26, c1, c2, in, out) \
-  RND(ctx, a, 26, b,  3, c, 10, d, 13, e, 24, f, 24, c1, c2, in, out) \
-  RND(ctx, a, 24, b,  1, c,  8, d, 11, e, 22, f, 22, c1, c2, in, out) \
-  RND(ctx, a, 22, b, 31, c,  6, d,  9, e, 20, f, 20, c1, c2, in, out) \
-  RND(ctx, a, 20, b, 29, c,  4, d,  7, e, 18, f, 18, c1, c2, in, out) \
-  RND(ctx, a, 18, b, 27, c,  2, d,  5, e, 16, f, 16, c1, c2, in, out) \
-  RND(ctx, a, 16, b, 25, c,  0, d,  3, e, 14, f, 14, c1, c2, in, out) \
-  RND(ctx, a, 14, b, 23, c, 30, d,  1, e, 12, f, 12, c1, c2, in, out) \
-  RND(ctx, a, 12, b, 21, c, 28, d, 31, e, 10, f, 10, c1, c2, in, out) \
-  RND(ctx, a, 10, b, 19, c, 26, d, 29, e,  8, f,  8, c1, c2, in, out) \
-  RND(ctx, a,  8, b, 17, c, 24, d, 27, e,  6, f,  6, c1, c2, in, out) \
-  RND(ctx, a,  6, b, 15, c, 22, d, 25, e,  4, f,  4, c1, c2, in, out) \
-  RND(ctx, a,  4, b, 13, c, 20, d, 23, e,  2, f,  2, c1, c2, in, out) \
-  RND(ctx, a,  2, b, 11, c, 18, d, 21, e,  0, f,  0, c1, c2, in, out) 
+DRAGON_DEFINE_BLOCKS(dragon_scalar_blocks)
 
 /**
  * Generate #(blocks) 64-bit blocks of keystream. 
@@ -298,28 +293,14 @@ void ECRYPT_keystream_blocks(
   u8* keystream,
   u32 blocks)
 {
-    u32 *k_ptr = (u32*)keystream;
-    u32 a, b, c, d, e, f;
-
-     u32 c1, c2;
-
     assert(ctx && keystream);
 
-    c1 = ctx->state_counter[0];
-    c2 = ctx->state_counter[1];
-
-    while (blocks > 0) {
-        DRAGON_16RND(KEYSTREAM_RND, ctx, a, b, c, d, e, f, c1, c2, k_ptr, k_ptr)
-        blocks -= 16;
-    }
-    if (c2 < ctx->state_counter[1]) {
-        ctx->state_counter[0] = c1+1;
-    }
-    ctx->state_counter[1] = c2;
+    dragon_bound_kernel()->blocks(ctx, NULL, keystream, blocks);
 }
 
 /**
- * Encrypt/Decrypt #(blocks) 64-bit blocks of text
+ * Encrypt/Decrypt #(blocks) 64-bit blocks of text. With the scalar
+ * kernels the buffers need no alignment and may be the same.
  * @param  action  [In]         This parameter has no meaning for Dragon
  * @param  ctx     [In/Out]  Dragon context
  * @param  input   [In]      (plain/cipher)text blocks for (en/de)crypting
@@ -334,31 +315,68 @@ void ECRYPT_process_blocks(
   u8* output, 
   u32 blocks)
 { 
-    u32 *in = (u32*)input;
-    u32 *out = (u32*)output;
-
-    u32 a, b, c, d, e, f;
-    u32 c1, c2;
-
     assert(ctx && input && output);
 
-    c1 = ctx->state_counter[0];
-    c2 = ctx->state_counter[1];
+    dragon_bound_kernel()->blocks(ctx, input, output, blocks);
+}
 
-    while (blocks > 0) {
-        DRAGON_16RND(PROCESS_RND, ctx, a, b, c, d, e, f, c1, c2, in, out)
-        blocks-=16;
+/*
+ * Stream #(length) bytes: drain the keystream left in keystream_buffer
+ * by the previous call, run the whole blocks through the block kernel
+ * directly from input to output, and buffer a fresh 16 blocks for the
+ * final partial block. buffer_index counts the unused bytes at the end
+ * of keystream_buffer. A NULL input selects keystream generation.
+ */
+static void dragon_bytes(
+    ECRYPT_ctx* ctx,
+    const u8* input,
+    u8* output,
+    size_t length)
+{
+    u8* buffered;
+    size_t blocks;
+    size_t n;
+
+    n = ctx->buffer_index < length ? ctx->buffer_index : length;
+    if (n > 0) {
+        buffered = ctx->keystream_buffer + DRAGON_BUFFER_BYTES - ctx->buffer_index;
+        if (input) {
+            dragon_xor(output, input, buffered, n);
+            input += n;
+        } else {
+            memcpy(output, buffered, n);
+        }
+        ctx->buffer_index -= (u32)n;
+        output += n;
+        length -= n;
     }
-    if (c2 < ctx->state_counter[1]) {
-        ctx->state_counter[0] = c1+1;
+
+    /* the kernels count blocks in 32 bits */
+    while ((blocks = length / ECRYPT_BLOCKLENGTH) > 0) {
+        if (blocks > DRAGON_BLOCKS_MAX) {
+            blocks = DRAGON_BLOCKS_MAX;
+        }
+        dragon_bound_kernel()->blocks(ctx, input, output, (u32)blocks);
+        n = blocks * ECRYPT_BLOCKLENGTH;
+        input = input ? input + n : NULL;
+        output += n;
+        length -= n;
+    }
+
+    if (length > 0) {
+        ECRYPT_keystream_blocks(ctx, ctx->keystream_buffer, DRAGON_BUFFER_SIZE);
+        if (input) {
+            dragon_xor(output, input, ctx->keystream_buffer, length);
+        } else {
+            memcpy(output, ctx->keystream_buffer, length);
+        }
+        ctx->buffer_index = DRAGON_BUFFER_BYTES - (u32)length;
     }
-    ctx->state_counter[1] = c2;
 }
 
 /**
- * Generate an arbitrary number of keystream bytes. Note this API 
- * is slower than block-wise encryption as Dragon is a 64-bit 
- * block-oriented  cipher
+ * Generate an arbitrary number of keystream bytes. Consecutive calls
+ * continue the keystream where the previous call stopped.
  *
  * @param  ctx        [In/Out]  Dragon context
  * @param  keystream  [Out]        pre-allocated array containing (msglen)
@@ -372,22 +390,13 @@ void ECRYPT_keystream_bytes(
 {
     assert(ctx && keystream);
 
-    while ((length--) > 0) {
-        if (ctx->buffer_index == 0) {
-            ECRYPT_keystream_blocks(
-                ctx, 
-                ctx->keystream_buffer, 
-                DRAGON_BUFFER_SIZE);
-        }
-        *(keystream++) = ctx->keystream_buffer[ctx->buffer_index];
-        ctx->buffer_index = (ctx->buffer_index % DRAGON_BUFFER_SIZE);
-    }
+    dragon_bytes(ctx, NULL, keystream, length);
 }
 
 /**
- * Encrypt an arbitrary number of bytes. Note this API is slower
- * than block-wise encryption as Dragon is a 64-bit block-oriented 
- * cipher
+ * Encrypt an arbitrary number of bytes. Consecutive calls continue the
+ * keystream where the previous call stopped, so a message may be
+ * processed in pieces of any size.
  *
  * @param  action  [In]      This parameter has no meaning for Dragon
  * @param  ctx     [In/Out]  Dragon context
@@ -402,15 +411,83 @@ void ECRYPT_process_bytes(
     u8* output,
     u32 msglen)
 {
-    u32 len = msglen;
-    u32 i;
+    assert(ctx && input && output);
+
+    dragon_bytes(ctx, input, output, msglen);
+}
 
+/**
+ * As ECRYPT_keystream_bytes(), for any length that fits in memory.
+ */
+void DRAGON_keystream_bytes_long(
+    ECRYPT_ctx* ctx,
+    u8* keystream,
+    size_t length)
+{
+    assert(ctx && keystream);
+
+    dragon_bytes(ctx, NULL, keystream, length);
+}
+
+/**
+ * As ECRYPT_process_bytes(), for any length that fits in memory.
+ */
+void DRAGON_process_bytes_long(
+    int action,                 /* 0 = encrypt; 1 = decrypt; */
+    ECRYPT_ctx* ctx,
+    const u8* input,
+    u8* output,
+    size_t msglen)
+{
     assert(ctx && input && output);
 
-    ECRYPT_keystream_bytes(ctx, output, len);
+    dragon_bytes(ctx, input, output, msglen);
+}
 
-    for (i = 0; i < msglen; i++) {
-        output[i] ^= input[i];
+/*
+ * Block counts beyond 32 bits go to the kernel in DRAGON_BLOCKS_MAX
+ * pieces; the counter carries across them as within a call.
+ */
+static void dragon_blocks_long(
+    ECRYPT_ctx* ctx,
+    const u8* input,
+    u8* output,
+    size_t blocks)
+{
+    size_t n;
+
+    for (; blocks > 0; blocks -= n) {
+        n = blocks < DRAGON_BLOCKS_MAX ? blocks : DRAGON_BLOCKS_MAX;
+        dragon_bound_kernel()->blocks(ctx, input, output, (u32)n);
+        input = input ? input + n * ECRYPT_BLOCKLENGTH : NULL;
+        output += n * ECRYPT_BLOCKLENGTH;
     }
 }
 
+/**
+ * As ECRYPT_keystream_blocks(), for any number of blocks.
+ */
+void DRAGON_keystream_blocks_long(
+    ECRYPT_ctx* ctx,
+    u8* keystream,
+    size_t blocks)
+{
+    assert(ctx && keystream);
+
+    dragon_blocks_long(ctx, NULL, keystream, blocks);
+}
+
+/**
+ * As ECRYPT_process_blocks(), for any number of blocks.
+ */
+void DRAGON_process_blocks_long(
+    int action,                 /* 0 = encrypt; 1 = decrypt; */
+    ECRYPT_ctx* ctx,
+    const u8* input,
+    u8* output,
+    size_t blocks)
+{
+    assert(ctx && input && output);
+
+    dragon_blocks_long(ctx, input, output, blocks);
+}
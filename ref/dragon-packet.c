@@ -0,0 +1,135 @@
+/**
+ * @file dragon-packet.c
+ * Batched packet encryption with Dragon
+ * This source is provided without warranty
+ * or guarantee of any kind. Use at your own risk.
+ */
+#include <assert.h>
+#include <stddef.h>
+
+#include "dragon-multi.h"
+#include "dragon-xor.h"
+
+#define DRAGON_GROUP_BYTES  (16 * ECRYPT_BLOCKLENGTH)
+
+/*
+ * Run the whole 16-block groups of up to DRAGON_PACKET_LANES packets
+ * through the bound multi-stream kernel. Lanes are ordered by group
+ * count, longest first; each call covers the lanes still busy for as
+ * many groups as the shortest of them needs, so every lane advances in
+ * step until it runs out.
+ */
+static void dragon_packet_groups(
+  int action,
+  ECRYPT_ctx** ctx,
+  const u8** input,
+  u8** output,
+  const u32* groups,
+  u32 lanes)
+{
+    u32 order[DRAGON_PACKET_LANES];
+    ECRYPT_ctx* lane_ctx[DRAGON_PACKET_LANES];
+    const u8* lane_in[DRAGON_PACKET_LANES];
+    u8* lane_out[DRAGON_PACKET_LANES];
+    u32 i, j, busy, done, step;
+
+    for (i = 0; i < lanes; i++) {
+        for (j = i; j > 0 && groups[order[j - 1]] < groups[i]; j--) {
+            order[j] = order[j - 1];
+        }
+        order[j] = i;
+    }
+    for (i = 0; i < lanes; i++) {
+        lane_ctx[i] = ctx[order[i]];
+        lane_in[i]  = input[order[i]];
+        lane_out[i] = output[order[i]];
+    }
+
+    for (busy = lanes, done = 0; busy > 0; done += step) {
+        while (busy > 0 && groups[order[busy - 1]] == done) {
+            busy--;
+        }
+        if (busy == 0) {
+            break;
+        }
+        step = groups[order[busy - 1]] - done;
+        DRAGON_process_blocks_multi(action, lane_ctx, lane_in, lane_out,
+                                    busy, 16 * step);
+        for (i = 0; i < busy; i++) {
+            lane_in[i]  += step * DRAGON_GROUP_BYTES;
+            lane_out[i] += step * DRAGON_GROUP_BYTES;
+        }
+    }
+}
+
+/**
+ * Encrypt/Decrypt #(packets) packets, each under its own IV, with the
+ * key of ctx. Packets are taken DRAGON_PACKET_LANES at a time: the IV
+ * setups share DRAGON_ivsetup_multi(), and the whole 16-block groups of
+ * all packets share the bound multi-stream kernel. The last, partial
+ * group of every packet is then generated by one more kernel call, as
+ * a group of keystream per lane, and only its msglen % 128 bytes are
+ * combined with the text; packets shorter than a group take only that
+ * call.
+ * @param  action   [In]  This parameter has no meaning for Dragon
+ * @param  ctx      [In]  Dragon context after ECRYPT_keysetup()
+ * @param  iv       [In]  array of IVs
+ * @param  input    [In]  array of (plain/cipher)texts
+ * @param  output   [Out] array of pre-allocated (cipher/plain)text buffers
+ * @param  msglen   [In]  array of message lengths in bytes
+ * @param  packets  [In]  number of packets
+ */
+void DRAGON_process_packets(
+  int action,                 /* 0 = encrypt; 1 = decrypt; */
+  const ECRYPT_ctx* ctx,
+  const u8** iv,
+  const u8** input,
+  u8** output,
+  const u32* msglen,
+  u32 packets)
+{
+    ECRYPT_ctx lane[DRAGON_PACKET_LANES];
+    ECRYPT_ctx* lane_ctx[DRAGON_PACKET_LANES];
+    u8 tail[DRAGON_PACKET_LANES][DRAGON_GROUP_BYTES];
+    u8* tail_ks[DRAGON_PACKET_LANES];
+    u32 groups[DRAGON_PACKET_LANES];
+    u32 lanes, tails, i, n;
+
+    assert(ctx && iv && input && output && msglen);
+
+    for (; packets > 0; packets -= lanes) {
+        lanes = packets < DRAGON_PACKET_LANES ? packets : DRAGON_PACKET_LANES;
+
+        for (i = 0; i < lanes; i++) {
+            lane[i] = *ctx;
+            lane_ctx[i] = &lane[i];
+            groups[i] = msglen[i] / DRAGON_GROUP_BYTES;
+        }
+        DRAGON_ivsetup_multi(lane_ctx, iv, lanes);
+
+        dragon_packet_groups(action, lane_ctx, input, output, groups, lanes);
+
+        for (i = 0, tails = 0; i < lanes; i++) {
+            if (msglen[i] % DRAGON_GROUP_BYTES) {
+                lane_ctx[tails] = &lane[i];
+                tail_ks[tails]  = tail[tails];
+                tails++;
+            }
+        }
+        if (tails > 0) {
+            DRAGON_keystream_blocks_multi(lane_ctx, tail_ks, tails, 16);
+        }
+        for (i = 0, tails = 0; i < lanes; i++) {
+            n = groups[i] * DRAGON_GROUP_BYTES;
+            if (msglen[i] > n) {
+                dragon_xor(output[i] + n, input[i] + n, tail[tails++],
+                           msglen[i] - n);
+            }
+        }
+
+        iv += lanes;
+        input += lanes;
+        output += lanes;
+        msglen += lanes;
+    }
+}
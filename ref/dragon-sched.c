@@ -0,0 +1,226 @@
+/**
+ * @file dragon-sched.c
+ * Lane-packing scheduler for Dragon streams
+ * This source is provided without warranty
+ * or guarantee of any kind. Use at your own risk.
+ */
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dragon-sched.h"
+#include "dragon-multi.h"
+
+#define DRAGON_GROUP_BYTES  (16 * ECRYPT_BLOCKLENGTH)
+
+typedef struct
+{
+    ECRYPT_ctx* ctx;
+    const u8*   input;
+    u8*         output;
+    u32         groups;       /* whole 16-block groups left */
+    u32         tail;         /* bytes after the last group */
+    void      (*done)(void* arg);
+    void*       arg;
+    u64         since;        /* time of submission */
+} dragon_job;
+
+struct dragon_sched
+{
+    dragon_job* queue;        /* ring of jobs waiting for a lane */
+    u32  capacity;
+    u32  head;
+    u32  queued;
+    dragon_job lane[DRAGON_SCHED_LANES];
+    u32  busy;                /* lanes 0..busy-1 hold jobs */
+    u64  max_wait;
+    dragon_sched_stats stats;
+};
+
+dragon_sched* DRAGON_sched_create(
+  u32 queue,
+  u64 max_wait)
+{
+    dragon_sched* sched;
+
+    assert(queue > 0);
+
+    sched = calloc(1, sizeof(*sched));
+    if (!sched) {
+        return NULL;
+    }
+    sched->queue = malloc(queue * sizeof(*sched->queue));
+    if (!sched->queue) {
+        free(sched);
+        return NULL;
+    }
+    sched->capacity = queue;
+    sched->max_wait = max_wait;
+    return sched;
+}
+
+void DRAGON_sched_destroy(dragon_sched* sched)
+{
+    if (!sched) {
+        return;
+    }
+    free(sched->queue);
+    free(sched);
+}
+
+static void dragon_job_finish(dragon_sched* sched, dragon_job* job)
+{
+    ECRYPT_process_bytes(0, job->ctx, job->input, job->output, job->tail);
+    sched->stats.jobs++;
+    if (job->done) {
+        job->done(job->arg);
+    }
+}
+
+/*
+ * Fill idle lanes from the queue and run them as long as all lanes are
+ * busy, a busy job is older than max_wait, or flush is set. Each call
+ * runs the groups of the shortest busy job, which then retires.
+ */
+static void dragon_sched_run(
+  dragon_sched* sched,
+  u64 now,
+  int flush)
+{
+    ECRYPT_ctx* ctx[DRAGON_SCHED_LANES];
+    const u8* input[DRAGON_SCHED_LANES];
+    u8* output[DRAGON_SCHED_LANES];
+    dragon_job* job;
+    u32 i, step;
+    int expired;
+
+    for (;;) {
+        while (sched->busy < DRAGON_SCHED_LANES && sched->queued > 0) {
+            sched->lane[sched->busy++] = sched->queue[sched->head];
+            sched->head = (sched->head + 1) % sched->capacity;
+            sched->queued--;
+        }
+        if (sched->busy == 0) {
+            return;
+        }
+
+        expired = flush;
+        step = sched->lane[0].groups;
+        for (i = 0; i < sched->busy; i++) {
+            job = &sched->lane[i];
+            if (now >= job->since && now - job->since >= sched->max_wait) {
+                expired = 1;
+            }
+            if (job->groups < step) {
+                step = job->groups;
+            }
+            ctx[i]    = job->ctx;
+            input[i]  = job->input;
+            output[i] = job->output;
+        }
+        if (sched->busy < DRAGON_SCHED_LANES) {
+            if (!expired) {
+                return;
+            }
+            sched->stats.forced_calls++;
+        }
+
+        DRAGON_process_blocks_multi(0, ctx, input, output, sched->busy,
+                                    16 * step);
+        sched->stats.calls++;
+        sched->stats.busy_groups += (u64)sched->busy * step;
+        sched->stats.lane_groups += (u64)DRAGON_SCHED_LANES * step;
+
+        for (i = sched->busy; i-- > 0; ) {
+            job = &sched->lane[i];
+            job->groups -= step;
+            job->input  += (size_t)step * DRAGON_GROUP_BYTES;
+            job->output += (size_t)step * DRAGON_GROUP_BYTES;
+            if (job->groups == 0) {
+                dragon_job_finish(sched, job);
+                *job = sched->lane[--sched->busy];
+            }
+        }
+    }
+}
+
+int DRAGON_sched_submit(
+  dragon_sched* sched,
+  ECRYPT_ctx* ctx,
+  const u8* input,
+  u8* output,
+  u32 msglen,
+  void (*done)(void* arg),
+  void* arg,
+  u64 now)
+{
+    dragon_job job;
+    u32 n;
+
+    assert(sched && ctx && input && output);
+
+    if (sched->queued == sched->capacity) {
+        return -1;
+    }
+
+    /* the kernels start at a block boundary: use up buffered keystream */
+    n = ctx->buffer_index < msglen ? ctx->buffer_index : msglen;
+    if (n > 0) {
+        ECRYPT_process_bytes(0, ctx, input, output, n);
+    }
+
+    job.ctx    = ctx;
+    job.input  = input + n;
+    job.output = output + n;
+    job.groups = (msglen - n) / DRAGON_GROUP_BYTES;
+    job.tail   = (msglen - n) % DRAGON_GROUP_BYTES;
+    job.done   = done;
+    job.arg    = arg;
+    job.since  = now;
+
+    if (job.groups == 0) {
+        sched->stats.short_jobs++;
+        dragon_job_finish(sched, &job);
+        return 0;
+    }
+
+    sched->queue[(sched->head + sched->queued) % sched->capacity] = job;
+    sched->queued++;
+    if (sched->queued > sched->stats.max_queued) {
+        sched->stats.max_queued = sched->queued;
+    }
+    dragon_sched_run(sched, now, 0);
+    return 0;
+}
+
+void DRAGON_sched_poll(
+  dragon_sched* sched,
+  u64 now)
+{
+    assert(sched);
+
+    dragon_sched_run(sched, now, 0);
+}
+
+void DRAGON_sched_flush(dragon_sched* sched)
+{
+    assert(sched);
+
+    dragon_sched_run(sched, 0, 1);
+}
+
+u32 DRAGON_sched_pending(const dragon_sched* sched)
+{
+    assert(sched);
+
+    return sched->queued + sched->busy;
+}
+
+void DRAGON_sched_stats(
+  const dragon_sched* sched,
+  dragon_sched_stats* stats)
+{
+    assert(sched && stats);
+
+    *stats = sched->stats;
+}
@@ -0,0 +1,123 @@
+/**
+ * @file dragon-sched.h
+ * Lane-packing scheduler for Dragon streams
+ * This source is provided without warranty
+ * or guarantee of any kind. Use at your own risk.
+ */
+#ifndef DRAGON_SCHED
+#define DRAGON_SCHED
+
+#ifndef _DRAGON_OPT
+#define _DRAGON_OPT
+#endif
+
+#include "ecrypt-sync.h"
+
+/* ------------------------------------------------------------------------- */
+
+/* A scheduler queues encrypt/decrypt jobs of independent streams as they
+   arrive and runs their whole 16-block groups DRAGON_SCHED_LANES at a
+   time through the bound multi-stream kernel. Each kernel call lasts
+   as many groups as the shortest busy lane needs; that job then
+   retires, and its lane is refilled from the queue before the next
+   call. Jobs shorter than one group never take a lane.
+
+   While fewer jobs are pending than there are lanes, the lanes are only
+   run once a job has waited max_wait, or on DRAGON_sched_flush(). Time
+   is whatever monotonic unit the caller passes as now. Every job is
+   finished, and its callback run, within the submit, poll or flush
+   call that completes it; callbacks must not call into the scheduler.
+   A context may have at most one job pending. A scheduler is not
+   thread-safe. */
+
+#define DRAGON_SCHED_LANES    16
+
+typedef struct dragon_sched dragon_sched;
+
+typedef struct
+{
+    u64  jobs;                /* jobs finished */
+    u64  short_jobs;          /* of those, jobs that never took a lane */
+    u64  calls;               /* multi-stream kernel calls */
+    u64  forced_calls;        /* calls with idle lanes, by age or flush */
+    u64  busy_groups;         /* groups run, summed over busy lanes */
+    u64  lane_groups;         /* groups offered, summed over all lanes */
+    u32  max_queued;          /* deepest queue seen */
+} dragon_sched_stats;
+
+/**
+ * Create a scheduler.
+ * @param  queue     [In]  maximum number of jobs waiting for a lane, at
+ *                         least 1
+ * @param  max_wait  [In]  age in units of now after which a job runs
+ *                         without waiting for full lanes
+ * @return the scheduler, or NULL if it cannot be allocated
+ */
+dragon_sched* DRAGON_sched_create(
+  u32 queue,
+  u64 max_wait);
+
+/**
+ * Free a scheduler. Pending jobs are dropped.
+ * @param  sched  [In]  scheduler, or NULL
+ */
+void DRAGON_sched_destroy(dragon_sched* sched);
+
+/**
+ * Queue a job that encrypts/decrypts #(msglen) bytes, continuing the
+ * stream of ctx as ECRYPT_process_bytes() does, then runs the kernel
+ * while the lanes can be filled.
+ * @param  sched   [In/Out]  scheduler
+ * @param  ctx     [In/Out]  Dragon context, untouched by the caller
+ *                           until the job is done
+ * @param  input   [In]      (plain/cipher)text
+ * @param  output  [Out]     pre-allocated array of (msglen) bytes
+ * @param  msglen  [In]      number of bytes
+ * @param  done    [In]      called with arg when the job is done, or NULL
+ * @param  arg     [In]      argument of done
+ * @param  now     [In]      current time
+ * @return 0 on success, -1 if the queue is full
+ */
+int DRAGON_sched_submit(
+  dragon_sched* sched,
+  ECRYPT_ctx* ctx,
+  const u8* input,
+  u8* output,
+  u32 msglen,
+  void (*done)(void* arg),
+  void* arg,
+  u64 now);
+
+/**
+ * Run the kernel while the lanes can be filled, or while a job older
+ * than max_wait is pending.
+ * @param  sched  [In/Out]  scheduler
+ * @param  now    [In]      current time
+ */
+void DRAGON_sched_poll(
+  dragon_sched* sched,
+  u64 now);
+
+/**
+ * Finish all pending jobs.
+ * @param  sched  [In/Out]  scheduler
+ */
+void DRAGON_sched_flush(dragon_sched* sched);
+
+/**
+ * @return number of jobs pending
+ */
+u32 DRAGON_sched_pending(const dragon_sched* sched);
+
+/**
+ * Read the statistics. busy_groups / lane_groups is the lane occupancy.
+ * @param  sched  [In]   scheduler
+ * @param  stats  [Out]  statistics
+ */
+void DRAGON_sched_stats(
+  const dragon_sched* sched,
+  dragon_sched_stats* stats);
+
+/* ------------------------------------------------------------------------- */
+
+#endif
@@ -0,0 +1,174 @@
+/**
+ * @file dragon-schedule.h
+ * Unrolled Dragon round schedule shared by the block kernels
+ * This source is provided without warranty
+ * or guarantee of any kind. Use at your own risk.
+ */
+#ifndef DRAGON_SCHEDULE
+#define DRAGON_SCHEDULE
+
+#include "dragon-xor.h"
+
+/**
+ * DRAGON_ROUND produces one block of keystream
+ */
+#define BASIC_RND(ctx, a, loc_a, b, loc_b, c, loc_c, \
+                         d, loc_d, e, loc_e, f, loc_fb1, c1, c2)\
+    a = ctx->nlfsr_word[loc_a]; \
+    c = ctx->nlfsr_word[loc_c]; \
+    e = ctx->nlfsr_word[loc_e] ^ c1; \
+    b = ctx->nlfsr_word[loc_b] ^ a; \
+    d = ctx->nlfsr_word[loc_d] ^ c; \
+    f = (ctx->nlfsr_word[loc_e+1] ^ e) ^ (c2++); \
+    c += b; \
+    e += d; \
+    a += f; \
+    f ^= G2(c); b ^= G3(e); d ^= G1(a); \
+    e ^= H3(f); a ^= H1(b); c ^= H2(d); \
+    ctx->nlfsr_word[loc_fb1] = b + e;  \
+    ctx->nlfsr_word[loc_fb1+1] = c ^ (b + e); 
+
+#define KEYSTREAM_RND(ctx, a, loc_a, b, loc_b, c, loc_c, \
+                         d, loc_d, e, loc_e, f, loc_fb1, c1, c2, in, out)\
+    BASIC_RND(ctx, a, loc_a, b, loc_b, c, loc_c, \
+       d, loc_d, e, loc_e, f, loc_fb1, c1, c2) \
+    *(out++) = a ^ (f + c); \
+    *(out++) = e ^ (d + a);  
+
+/**
+ * DRAGON_16RND produces 16 blocks of keystream. The NLFSR locations are
+ * fixed per round; after 16 rounds the circular buffer has rotated back
+ * to its starting position.
+ */
+#define DRAGON_16RND(RND, ctx, a, b, c, d, e, f, c1, c2, in, out) \
+  RND(ctx, a,  0, b,  9, c, 16, d, 19, e, 30, f, 30, c1, c2, in, out) \
+  RND(ctx, a, 30, b,  7, c, 14, d, 17, e, 28, f, 28, c1, c2, in, out) \
+  RND(ctx, a, 28, b,  5, c, 12, d, 15, e, 26, f, 26, c1, c2, in, out) \
+  RND(ctx, a, 26, b,  3, c, 10, d, 13, e, 24, f, 24, c1, c2, in, out) \
+  RND(ctx, a, 24, b,  1, c,  8, d, 11, e, 22, f, 22, c1, c2, in, out) \
+  RND(ctx, a, 22, b, 31, c,  6, d,  9, e, 20, f, 20, c1, c2, in, out) \
+  RND(ctx, a, 20, b, 29, c,  4, d,  7, e, 18, f, 18, c1, c2, in, out) \
+  RND(ctx, a, 18, b, 27, c,  2, d,  5, e, 16, f, 16, c1, c2, in, out) \
+  RND(ctx, a, 16, b, 25, c,  0, d,  3, e, 14, f, 14, c1, c2, in, out) \
+  RND(ctx, a, 14, b, 23, c, 30, d,  1, e, 12, f, 12, c1, c2, in, out) \
+  RND(ctx, a, 12, b, 21, c, 28, d, 31, e, 10, f, 10, c1, c2, in, out) \
+  RND(ctx, a, 10, b, 19, c, 26, d, 29, e,  8, f,  8, c1, c2, in, out) \
+  RND(ctx, a,  8, b, 17, c, 24, d, 27, e,  6, f,  6, c1, c2, in, out) \
+  RND(ctx, a,  6, b, 15, c, 22, d, 25, e,  4, f,  4, c1, c2, in, out) \
+  RND(ctx, a,  4, b, 13, c, 20, d, 23, e,  2, f,  2, c1, c2, in, out) \
+  RND(ctx, a,  2, b, 11, c, 18, d, 21, e,  0, f,  0, c1, c2, in, out)
+
+
+/**
+ * DRAGON_16MIX runs the DRAGON_MIXING_STAGES stages of the IV setup on
+ * an NLFSR at fixed locations. Stage s starts at ring offset 28*s mod 32;
+ * MIX(nlfsr, a, b, c, d, e, f, o) performs the stage at offset o.
+ */
+#define DRAGON_16MIX(MIX, nlfsr, a, b, c, d, e, f) \
+  MIX(nlfsr, a, b, c, d, e, f,  0) MIX(nlfsr, a, b, c, d, e, f, 28) \
+  MIX(nlfsr, a, b, c, d, e, f, 24) MIX(nlfsr, a, b, c, d, e, f, 20) \
+  MIX(nlfsr, a, b, c, d, e, f, 16) MIX(nlfsr, a, b, c, d, e, f, 12) \
+  MIX(nlfsr, a, b, c, d, e, f,  8) MIX(nlfsr, a, b, c, d, e, f,  4) \
+  MIX(nlfsr, a, b, c, d, e, f,  0) MIX(nlfsr, a, b, c, d, e, f, 28) \
+  MIX(nlfsr, a, b, c, d, e, f, 24) MIX(nlfsr, a, b, c, d, e, f, 20) \
+  MIX(nlfsr, a, b, c, d, e, f, 16) MIX(nlfsr, a, b, c, d, e, f, 12) \
+  MIX(nlfsr, a, b, c, d, e, f,  8) MIX(nlfsr, a, b, c, d, e, f,  4)
+
+/**
+ * RING_RND produces one block of keystream at ring offset o (always
+ * even), for runs shorter than DRAGON_16RND. The offset then moves back
+ * by two words.
+ */
+#define RING_RND(ctx, o, a, b, c, d, e, f, c1, c2, out) \
+    KEYSTREAM_RND(ctx, a, o, b, ((o + 9) & 31), c, ((o + 16) & 31), \
+       d, ((o + 19) & 31), e, ((o + 30) & 31), f, ((o + 30) & 31), \
+       c1, c2, out, out) \
+    o = (o + 30) & 31;
+
+/**
+ * CARRY_16RND produces 16 blocks of keystream like DRAGON_16RND, for a
+ * group during which the low counter word wraps: the rounds go through
+ * RING_RND one at a time, carrying into c1 after each. 16 rounds take
+ * the ring offset o back to where it was.
+ */
+#define CARRY_16RND(ctx, o, a, b, c, d, e, f, c1, c2, out, end) \
+    for (end = out + 32; out < end; ) { \
+        RING_RND(ctx, o, a, b, c, d, e, f, c1, c2, out) \
+        c1 += (c2 == 0); \
+    }
+
+/*
+ * Rotate the NLFSR words so that ring offset o becomes location 0; the
+ * fixed-location kernels all start from there.
+ */
+static inline void dragon_ring_rebase(ECRYPT_ctx* ctx, u32 o)
+{
+    u32 t[DRAGON_NLFSR_SIZE];
+    u32 i;
+
+    for (i = 0; i < DRAGON_NLFSR_SIZE; i++) {
+        t[i] = ctx->nlfsr_word[(o + i) & (DRAGON_NLFSR_SIZE - 1)];
+    }
+    for (i = 0; i < DRAGON_NLFSR_SIZE; i++) {
+        ctx->nlfsr_word[i] = t[i];
+    }
+}
+
+/**
+ * DRAGON_DEFINE_BLOCKS defines a scalar block kernel with the signature
+ * of dragon_scalar_blocks(), built on whichever G1..H3 macros are in
+ * scope where it is expanded. Each 16 blocks the rounds fill an aligned
+ * buffer with keystream words in host byte order, which
+ * dragon_xor_be32() then stores big-endian, or combines with the input.
+ * The text is only accessed bytewise or through unaligned vector loads
+ * and stores, so it may start at any address, and output may equal
+ * input. A final run of fewer than 16 blocks goes through RING_RND,
+ * after which the NLFSR is rebased so that every call starts at
+ * location 0 again. The 64-bit counter carries after every group of 16
+ * blocks, or after every block in the rare group that wraps the low
+ * word.
+ */
+#define DRAGON_DEFINE_BLOCKS(name) \
+void name( \
+  ECRYPT_ctx* ctx, \
+  const u8* input, \
+  u8* output, \
+  u32 blocks) \
+{ \
+    u32 ks[32] __attribute__((aligned(32))); \
+    u32 *k, *end; \
+ \
+    u32 a, b, c, d, e, f; \
+    u32 c1, c2; \
+    u32 o = 0; \
+ \
+    c1 = ctx->state_counter[0]; \
+    c2 = ctx->state_counter[1]; \
+ \
+    for (; blocks >= 16; blocks -= 16) { \
+        k = ks; \
+        if (c2 > 0xFFFFFFF0) { \
+            CARRY_16RND(ctx, o, a, b, c, d, e, f, c1, c2, k, end) \
+        } else { \
+            DRAGON_16RND(KEYSTREAM_RND, ctx, a, b, c, d, e, f, c1, c2, k, k) \
+            c1 += (c2 == 0); \
+        } \
+        dragon_xor_be32(output, input, ks, sizeof(ks)); \
+        input = input ? input + sizeof(ks) : NULL; \
+        output += sizeof(ks); \
+    } \
+    if (blocks > 0) { \
+        for (k = ks; k < ks + 2 * blocks; ) { \
+            RING_RND(ctx, o, a, b, c, d, e, f, c1, c2, k) \
+            c1 += (c2 == 0); \
+        } \
+        dragon_xor_be32(output, input, ks, 8 * blocks); \
+    } \
+    if (o != 0) { \
+        dragon_ring_rebase(ctx, o); \
+    } \
+    ctx->state_counter[0] = c1; \
+    ctx->state_counter[1] = c2; \
+}
+
+#endif
@@ -0,0 +1,132 @@
+/**
+ * @file dragon-stream.c
+ * Compact Dragon streams sharing one key state
+ * This source is provided without warranty
+ * or guarantee of any kind. Use at your own risk.
+ */
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "dragon-stream.h"
+#include "dragon-dispatch.h"
+#include "dragon-xor.h"
+
+void DRAGON_key_setup(
+  dragon_key* key,
+  const u8* k,
+  u32 keysize)
+{
+    ECRYPT_ctx ctx;
+
+    assert(key && k);
+
+    ECRYPT_keysetup(&ctx, k, keysize, keysize);
+    memcpy(key->init_state, ctx.init_state, sizeof(key->init_state));
+    key->key_size = keysize;
+}
+
+void DRAGON_stream_ivsetup(
+  dragon_stream* stream,
+  const dragon_key* key,
+  const u8* iv)
+{
+    ECRYPT_ctx ctx;
+
+    assert(stream && key && iv);
+
+    /* a context fresh from key setup mixes its own NLFSR */
+    memcpy(ctx.nlfsr_word, key->init_state, sizeof(ctx.nlfsr_word));
+    ctx.nlfsr_offset = 0;
+    ctx.key_size = key->key_size;
+    ctx.full_rekeying = 1;
+    ECRYPT_ivsetup(&ctx, iv);
+
+    memcpy(stream->nlfsr_word, ctx.nlfsr_word, sizeof(stream->nlfsr_word));
+    stream->state_counter[0] = ctx.state_counter[0];
+    stream->state_counter[1] = ctx.state_counter[1];
+    stream->tail_len = 0;
+}
+
+/*
+ * As dragon_bytes() in dragon-opt.c, with a one-block tail. The block
+ * kernels run on a context on the stack that only carries the NLFSR and
+ * the counter. A NULL input selects keystream generation.
+ */
+static void dragon_stream_bytes(
+  dragon_stream* stream,
+  const u8* input,
+  u8* output,
+  u32 length)
+{
+    ECRYPT_ctx ctx;
+    const u8* buffered;
+    u32 blocks;
+    u32 n;
+
+    n = stream->tail_len < length ? stream->tail_len : length;
+    if (n > 0) {
+        buffered = stream->tail + ECRYPT_BLOCKLENGTH - stream->tail_len;
+        if (input) {
+            dragon_xor(output, input, buffered, n);
+            input += n;
+        } else {
+            memcpy(output, buffered, n);
+        }
+        stream->tail_len -= n;
+        output += n;
+        length -= n;
+    }
+    if (length == 0) {
+        return;
+    }
+
+    memcpy(ctx.nlfsr_word, stream->nlfsr_word, sizeof(ctx.nlfsr_word));
+    ctx.state_counter[0] = stream->state_counter[0];
+    ctx.state_counter[1] = stream->state_counter[1];
+    ctx.nlfsr_offset = 0;
+
+    blocks = length / ECRYPT_BLOCKLENGTH;
+    if (blocks > 0) {
+        dragon_bound_kernel()->blocks(&ctx, input, output, blocks);
+        n = blocks * ECRYPT_BLOCKLENGTH;
+        input = input ? input + n : NULL;
+        output += n;
+        length -= n;
+    }
+    if (length > 0) {
+        dragon_bound_kernel()->blocks(&ctx, NULL, stream->tail, 1);
+        if (input) {
+            dragon_xor(output, input, stream->tail, length);
+        } else {
+            memcpy(output, stream->tail, length);
+        }
+        stream->tail_len = ECRYPT_BLOCKLENGTH - length;
+    }
+
+    memcpy(stream->nlfsr_word, ctx.nlfsr_word, sizeof(stream->nlfsr_word));
+    stream->state_counter[0] = ctx.state_counter[0];
+    stream->state_counter[1] = ctx.state_counter[1];
+}
+
+void DRAGON_stream_keystream(
+  dragon_stream* stream,
+  u8* keystream,
+  u32 length)
+{
+    assert(stream && keystream);
+
+    dragon_stream_bytes(stream, NULL, keystream, length);
+}
+
+void DRAGON_stream_process(
+  int action,                 /* 0 = encrypt; 1 = decrypt; */
+  dragon_stream* stream,
+  const u8* input,
+  u8* output,
+  u32 msglen)
+{
+    assert(stream && input && output);
+
+    dragon_stream_bytes(stream, input, output, msglen);
+}
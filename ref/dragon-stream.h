@@ -0,0 +1,92 @@
+/**
+ * @file dragon-stream.h
+ * Compact Dragon streams sharing one key state
+ * This source is provided without warranty
+ * or guarantee of any kind. Use at your own risk.
+ */
+#ifndef DRAGON_STREAM
+#define DRAGON_STREAM
+
+#ifndef _DRAGON_OPT
+#define _DRAGON_OPT
+#endif
+
+#include "ecrypt-sync.h"
+
+/* ------------------------------------------------------------------------- */
+
+/* An ECRYPT_ctx carries the post-keysetup NLFSR and a 128-byte
+   keystream buffer next to the running state, about 400 bytes per
+   stream. Here the key part lives in a dragon_key that any number of
+   streams share read-only, and a dragon_stream holds only the running
+   NLFSR, the counter and the unused rest of the last keystream block,
+   148 bytes. Between calls the NLFSR is always at ring offset 0, so no
+   offset is stored. */
+
+typedef struct
+{
+    u32  init_state[DRAGON_NLFSR_SIZE];  /* NLFSR after key injection */
+    u32  key_size;
+} dragon_key;
+
+typedef struct
+{
+    u32  nlfsr_word[DRAGON_NLFSR_SIZE];
+    u32  state_counter[2];
+    u8   tail[ECRYPT_BLOCKLENGTH];       /* keystream of the last block */
+    u32  tail_len;                       /* unused bytes at its end */
+} dragon_stream;
+
+/**
+ * Key setup, as ECRYPT_keysetup().
+ * @param  key      [Out]  key state
+ * @param  k        [In]   key
+ * @param  keysize  [In]   key size in bits, 128 or 256
+ */
+void DRAGON_key_setup(
+  dragon_key* key,
+  const u8* k,
+  u32 keysize);
+
+/**
+ * Start a stream under a key, as ECRYPT_ivsetup().
+ * @param  stream  [Out]  stream
+ * @param  key     [In]   key state, not modified
+ * @param  iv      [In]   IV of key->key_size bits
+ */
+void DRAGON_stream_ivsetup(
+  dragon_stream* stream,
+  const dragon_key* key,
+  const u8* iv);
+
+/**
+ * Generate #(length) bytes of keystream, continuing where the previous
+ * call stopped, as ECRYPT_keystream_bytes().
+ * @param  stream     [In/Out]  stream
+ * @param  keystream  [Out]     pre-allocated array of (length) bytes
+ * @param  length     [In]      number of bytes
+ */
+void DRAGON_stream_keystream(
+  dragon_stream* stream,
+  u8* keystream,
+  u32 length);
+
+/**
+ * Encrypt/Decrypt #(msglen) bytes, continuing where the previous call
+ * stopped, as ECRYPT_process_bytes(). output may equal input.
+ * @param  action  [In]      This parameter has no meaning for Dragon
+ * @param  stream  [In/Out]  stream
+ * @param  input   [In]      (plain/cipher)text
+ * @param  output  [Out]     pre-allocated array of (msglen) bytes
+ * @param  msglen  [In]      number of bytes
+ */
+void DRAGON_stream_process(
+  int action,                 /* 0 = encrypt; 1 = decrypt; */
+  dragon_stream* stream,
+  const u8* input,
+  u8* output,
+  u32 msglen);
+
+/* ------------------------------------------------------------------------- */
+
+#endif
@@ -0,0 +1,102 @@
+/**
+ * @file dragon-sync.h
+ * Durability policies for files written by the Dragon tools
+ * This source is provided without warranty
+ * or guarantee of any kind. Use at your own risk.
+ */
+#ifndef DRAGON_SYNC
+#define DRAGON_SYNC
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <unistd.h>
+
+/* When the output reaches stable storage, and what a crash leaves:
+
+   DRAGON_SYNC_NONE   never synced; even after a successful run, a crash
+                      may lose any part of the file.
+   DRAGON_SYNC_CLOSE  one fdatasync() before close (the default). Until
+                      it returns, a crash may leave any mix of written
+                      and missing blocks, not only a prefix; once it has
+                      returned, the whole file is stable.
+   DRAGON_SYNC_RANGE  as DRAGON_SYNC_CLOSE, and after every `every' bytes
+                      write-back of that range is started and the range
+                      before it is waited for (Linux sync_file_range),
+                      so dirty page cache stays below two ranges and the
+                      final fdatasync() is short. This gives no guarantee
+                      of its own: metadata and the drive cache are only
+                      flushed at close.
+   DRAGON_SYNC_WRITE  O_SYNC: every write() returns once stable. Slowest.
+                      What a crash leaves depends on how the tool writes:
+                      one write() after another (dragon's default loop
+                      and -p) leaves a prefix of the output. Writes kept
+                      in flight together (-u, io_uring) complete in any
+                      order, so only each finished write is stable and
+                      the file may have holes. A file that is sized
+                      first and written through a mapping (-m, msync per
+                      window) has its full length from the start: the
+                      windows synced so far are stable, the rest is any
+                      mix of new data and zeros. */
+
+#define DRAGON_SYNC_NONE   0
+#define DRAGON_SYNC_CLOSE  1
+#define DRAGON_SYNC_RANGE  2
+#define DRAGON_SYNC_WRITE  3
+
+typedef struct
+{
+    int      mode;
+    uint64_t every;           /* bytes per range, DRAGON_SYNC_RANGE */
+    uint64_t done;            /* write-back started below this offset */
+} dragon_sync;
+
+/**
+ * @return extra open() flags of the policy
+ */
+static inline int dragon_sync_flags(const dragon_sync* s)
+{
+    return s->mode == DRAGON_SYNC_WRITE ? O_SYNC : 0;
+}
+
+/**
+ * Report that the file has been written up to pos. Calls with a pos
+ * below an earlier one are allowed and do nothing.
+ * @param s    [In/Out]  policy
+ * @param fd   [In]      output file
+ * @param pos  [In]      end of the written data
+ */
+static inline void dragon_sync_progress(dragon_sync* s, int fd, uint64_t pos)
+{
+#if defined(SYNC_FILE_RANGE_WRITE)
+    if (s->mode != DRAGON_SYNC_RANGE || s->every == 0) {
+        return;
+    }
+    while (pos >= s->done + s->every) {
+        sync_file_range(fd, s->done, s->every, SYNC_FILE_RANGE_WRITE);
+        if (s->done >= s->every) {
+            sync_file_range(fd, s->done - s->every, s->every,
+                            SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+                            SYNC_FILE_RANGE_WAIT_AFTER);
+        }
+        s->done += s->every;
+    }
+#else
+    (void)s, (void)fd, (void)pos;
+#endif
+}
+
+/**
+ * Make the file as durable as the policy promises; call before close().
+ * @param s   [In]  policy
+ * @param fd  [In]  output file
+ * @return 0, or -1 if the data could not be synced
+ */
+static inline int dragon_sync_close(const dragon_sync* s, int fd)
+{
+    if (s->mode == DRAGON_SYNC_CLOSE || s->mode == DRAGON_SYNC_RANGE) {
+        return fdatasync(fd);
+    }
+    return 0;
+}
+
+#endif
@@ -0,0 +1,85 @@
+/**
+ * @file dragon-wide.c
+ * Dragon with 16-bit indexed s-box tables
+ * This source is provided without warranty
+ * or guarantee of any kind. Use at your own risk.
+ */
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "dragon-dispatch.h"
+#include "dragon-sboxes.c"
+
+/**
+ * Every 16-bit half of a G or H function is the XOR of two byte lookups
+ * into sbox1/sbox2, so only four distinct combinations occur:
+ *   wide_sbox[DRAGON_WIDE_xy][v] = sbox{x}[v & 0xFF] ^ sbox{y}[v >> 8]
+ * Each function then takes two loads and one XOR. The four tables take
+ * 1 MiB and are built on first use.
+ */
+#define DRAGON_WIDE_11  0
+#define DRAGON_WIDE_12  1
+#define DRAGON_WIDE_21  2
+#define DRAGON_WIDE_22  3
+
+static u32 (*wide_sbox)[65536];
+
+#define WIDE(lo, hi, x) \
+    (wide_sbox[DRAGON_WIDE_##lo][(x) & 0xFFFF] ^ \
+     wide_sbox[DRAGON_WIDE_##hi][(x) >> 16])
+
+#undef G1
+#undef G2
+#undef G3
+#undef H1
+#undef H2
+#undef H3
+
+#define G1(x) WIDE(21, 11, x)
+#define G2(x) WIDE(12, 11, x)
+#define G3(x) WIDE(11, 21, x)
+#define H1(x) WIDE(12, 22, x)
+#define H2(x) WIDE(21, 22, x)
+#define H3(x) WIDE(22, 12, x)
+
+#include "dragon-schedule.h"
+
+static void dragon_wide_build(void)
+{
+    static const u32* const sbox[2] = { sbox1, sbox2 };
+    u32 (*t)[65536];
+    u32 x, y, v;
+
+    t = malloc(4 * sizeof(*t));
+    if (!t) {
+        return;
+    }
+    for (x = 0; x < 2; x++) {
+        for (y = 0; y < 2; y++) {
+            for (v = 0; v < 65536; v++) {
+                t[2 * x + y][v] = sbox[x][v & 0xFF] ^ sbox[y][v >> 8];
+            }
+        }
+    }
+    wide_sbox = t;
+}
+
+/*
+ * Build the 16-bit tables, once per process; pthread_once orders the
+ * build before every return. Returns 0 on success, -1 if they cannot
+ * be allocated.
+ */
+int dragon_wide_init(void)
+{
+    static pthread_once_t built = PTHREAD_ONCE_INIT;
+
+    pthread_once(&built, dragon_wide_build);
+    return wide_sbox ? 0 : -1;
+}
+
+/**
+ * Scalar block kernel over the 16-bit tables; see dragon_scalar_blocks().
+ * dragon_wide_init() must have succeeded.
+ */
+DRAGON_DEFINE_BLOCKS(dragon_wide_blocks)
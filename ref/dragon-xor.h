@@ -0,0 +1,141 @@
+/**
+ * @file dragon-xor.h
+ * Keystream combine kernel shared by the Dragon implementations
+ * This source is provided without warranty
+ * or guarantee of any kind. Use at your own risk.
+ */
+#ifndef DRAGON_XOR
+#define DRAGON_XOR
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define DRAGON_HOST_BIG  1
+#else
+#define DRAGON_HOST_BIG  0
+#endif
+
+/**
+ * XOR #(len) bytes of keystream into text, 32 bytes per step with AVX2,
+ * 16 with SSE2, then bytewise. None of the buffers need to be aligned,
+ * and output may equal input.
+ * @param output     [Out]  ciphertext/plaintext
+ * @param input      [In]   plaintext/ciphertext
+ * @param keystream  [In]   keystream
+ * @param len        [In]   length in bytes
+ */
+static inline void dragon_xor(
+  uint8_t* output,
+  const uint8_t* input,
+  const uint8_t* keystream,
+  size_t len)
+{
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    for (; i + 32 <= len; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(input + i));
+        __m256i k = _mm256_loadu_si256((const __m256i*)(keystream + i));
+        _mm256_storeu_si256((__m256i*)(output + i), _mm256_xor_si256(x, k));
+    }
+#endif
+#if defined(__SSE2__)
+    for (; i + 16 <= len; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(input + i));
+        __m128i k = _mm_loadu_si128((const __m128i*)(keystream + i));
+        _mm_storeu_si128((__m128i*)(output + i), _mm_xor_si128(x, k));
+    }
+#endif
+    for (; i < len; i++) {
+        output[i] = input[i] ^ keystream[i];
+    }
+}
+
+/*
+ * Reverse the bytes of each 32-bit word: with one byte shuffle where
+ * SSSE3 is available, else by swapping the bytes of each 16-bit half and
+ * then the halves.
+ */
+#if defined(__AVX2__)
+static inline __m256i dragon_bswap32x8(__m256i x)
+{
+    const __m256i order = _mm256_setr_epi8(
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+    return _mm256_shuffle_epi8(x, order);
+}
+#endif
+
+#if defined(__SSE2__)
+static inline __m128i dragon_bswap32x4(__m128i x)
+{
+#if defined(__SSSE3__)
+    const __m128i order = _mm_setr_epi8(
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+    return _mm_shuffle_epi8(x, order);
+#else
+    x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0xB1), 0xB1);
+#endif
+}
+#endif
+
+/**
+ * XOR #(len) bytes of keystream, held as 32-bit words in host byte
+ * order, into text in the big-endian byte order of the cipher; with a
+ * NULL input the keystream bytes themselves are stored. On little-endian
+ * hosts the words are converted 8 or 4 at a time with byte shuffles.
+ * Only the keystream must be 4-byte aligned; output may equal input.
+ * @param output     [Out]  ciphertext/plaintext, or keystream
+ * @param input      [In]   plaintext/ciphertext, or NULL
+ * @param keystream  [In]   keystream words
+ * @param len        [In]   length in bytes
+ */
+static inline void dragon_xor_be32(
+  uint8_t* output,
+  const uint8_t* input,
+  const uint32_t* keystream,
+  size_t len)
+{
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    if (!DRAGON_HOST_BIG) {
+        for (; i + 32 <= len; i += 32) {
+            __m256i k = dragon_bswap32x8(
+                _mm256_loadu_si256((const __m256i*)(keystream + i / 4)));
+            if (input) {
+                k = _mm256_xor_si256(k,
+                    _mm256_loadu_si256((const __m256i*)(input + i)));
+            }
+            _mm256_storeu_si256((__m256i*)(output + i), k);
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    if (!DRAGON_HOST_BIG) {
+        for (; i + 16 <= len; i += 16) {
+            __m128i k = dragon_bswap32x4(
+                _mm_loadu_si128((const __m128i*)(keystream + i / 4)));
+            if (input) {
+                k = _mm_xor_si128(k, _mm_loadu_si128((const __m128i*)(input + i)));
+            }
+            _mm_storeu_si128((__m128i*)(output + i), k);
+        }
+    }
+#endif
+    for (; i < len; i++) {
+        uint8_t k = (uint8_t)(keystream[i >> 2] >> (24 - 8 * (i & 3)));
+
+        output[i] = input ? input[i] ^ k : k;
+    }
+}
+
+#endif
@@ -94,7 +94,7 @@ typedef struct
 	 * to the primitive.
 	 */
 	u8   keystream_buffer[DRAGON_BUFFER_BYTES]; 
-	u32  buffer_index;
+	u32  buffer_index;	/* dragon-opt: unused bytes at the buffer's end */
 } ECRYPT_ctx;
 
 /* ------------------------------------------------------------------------- */